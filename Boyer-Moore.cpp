@@ -3,12 +3,107 @@
 #include <string>
 #include <vector>
 #include <algorithm> // For std::max
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>  // Only with -std=c++20; the match generator is left out otherwise
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>  // SSE4.2, AVX2 and AVX-512 kernels, selected at runtime
+#endif
+
+// POSIX headers for the search daemon and match ring (sockets, mmap and shared memory)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "boyer_moore.h"  // C API, implemented at the end of this file
 
 // =========================
 // Constants and Type Aliases
 // =========================
 const int NUM_CHARS = 256;
 
+// Heuristic that produced a shift; used to index per-heuristic counters
+enum class Heuristic { BadCharacter, GoodSuffix };
+const int NUM_HEURISTICS = 2;
+
+/**
+* Describes the shift decision taken after a mismatch. The engine only fills in
+* integers and the enum here; turning them into text is left to the print functions.
+*/
+struct ShiftEvent {
+    int badCharShift;      // Shift proposed by the Bad Character table
+    int goodSuffixShift;   // Shift proposed by the Good Suffix table
+    Heuristic heuristic;   // Heuristic whose shift was applied
+    int shiftAmount;       // Distance the pattern was actually moved
+};
+
+/**
+* Counters collected while searching. `heuristicCounts` is indexed by `Heuristic`
+* and counts how often each rule decided the shift (full matches count as Good Suffix).
+* `shiftHistogram[h][d]` counts shifts of distance `d` produced by heuristic `h`.
+* Passing the same object to several searches accumulates over all of them.
+*/
+struct SearchStats {
+    int alignments = 0;
+    long long comparisons = 0;       // Character comparisons over all alignments
+    long long textBytes = 0;         // Total length of the texts searched
+    long long inspectedBytes = 0;    // Text bytes compared at least once
+    int heuristicCounts[NUM_HEURISTICS] = {};
+    std::vector<int> shiftHistogram[NUM_HEURISTICS];
+};
+
+const char* heuristicName(Heuristic heuristic) {
+    return heuristic == Heuristic::BadCharacter ? "Bad Character" : "Good Suffix";
+}
+
+void recordShift(SearchStats& stats, Heuristic heuristic, int distance) {
+    int h = static_cast<int>(heuristic);
+    stats.heuristicCounts[h]++;
+    std::vector<int>& histogram = stats.shiftHistogram[h];
+    if ((int)histogram.size() <= distance) histogram.resize(distance + 1, 0);
+    histogram[distance]++;
+}
+
+// Adds the counters of `stats` to `total`, e.g. to combine per-pattern stats into a corpus total
+void mergeSearchStats(SearchStats& total, const SearchStats& stats) {
+    total.alignments += stats.alignments;
+    total.comparisons += stats.comparisons;
+    total.textBytes += stats.textBytes;
+    total.inspectedBytes += stats.inspectedBytes;
+    for (int h = 0; h < NUM_HEURISTICS; h++) {
+        total.heuristicCounts[h] += stats.heuristicCounts[h];
+        std::vector<int>& histogram = total.shiftHistogram[h];
+        const std::vector<int>& other = stats.shiftHistogram[h];
+        if (histogram.size() < other.size()) histogram.resize(other.size(), 0);
+        for (int d = 0; d < (int)other.size(); d++) histogram[d] += other[d];
+    }
+}
+
 // =========================
 // Utility Print Functions
 // =========================
@@ -16,10 +111,57 @@ void printAlignmentStep(int step, int shift) {
     std::cout << "Step " << step << ": Pattern aligned at index " << shift << std::endl;
 }
 
-void printShiftDetails(int badCharShift, int goodSuffixShift, const std::string& heuristic, int shiftAmount) {
-    std::cout << "- Bad character shift: " << badCharShift;
-    std::cout << "      - Good suffix shift: " << goodSuffixShift;
-    std::cout << "      - Heuristic Chosen: " << heuristic << "      - Shifting right by: " << shiftAmount << std::endl;
+void printShiftDetails(const ShiftEvent& event) {
+    std::cout << "- Bad character shift: " << event.badCharShift;
+    std::cout << "      - Good suffix shift: " << event.goodSuffixShift;
+    std::cout << "      - Heuristic Chosen: " << heuristicName(event.heuristic)
+              << "      - Shifting right by: " << event.shiftAmount << std::endl;
+}
+
+void printHeuristicRatios(const SearchStats& stats) {
+    int decisions = 0;
+    for (int h = 0; h < NUM_HEURISTICS; h++) decisions += stats.heuristicCounts[h];
+    for (int h = 0; h < NUM_HEURISTICS; h++) {
+        int count = stats.heuristicCounts[h];
+        std::cout << heuristicName(static_cast<Heuristic>(h)) << " chosen: " << count;
+        if (decisions > 0) std::cout << " (" << (100.0 * count / decisions) << "%)";
+        std::cout << std::endl;
+    }
+}
+
+/**
+* Prints the skip-efficiency analytics gathered in `stats`: comparisons per alignment,
+* the fraction of text bytes that were ever inspected and the shift-distance histogram
+* of each heuristic. A high share of unit shifts means the skips have collapsed.
+*
+* @param label Name of what was measured, e.g. a pattern or "corpus"
+* @param stats The counters to report
+*/
+void printSearchReport(const std::string& label, const SearchStats& stats) {
+    std::cout << "Report for " << label << ":" << std::endl;
+    std::cout << "- Alignments: " << stats.alignments << "      - Comparisons: " << stats.comparisons;
+    if (stats.alignments > 0)
+        std::cout << "      - Comparisons per alignment: " << (double)stats.comparisons / stats.alignments;
+    std::cout << std::endl;
+    std::cout << "- Text bytes inspected: " << stats.inspectedBytes << " of " << stats.textBytes;
+    if (stats.textBytes > 0) std::cout << " (" << (100.0 * stats.inspectedBytes / stats.textBytes) << "%)";
+    std::cout << std::endl;
+
+    int shifts = 0;
+    int unitShifts = 0;
+    for (int h = 0; h < NUM_HEURISTICS; h++) {
+        const std::vector<int>& histogram = stats.shiftHistogram[h];
+        std::cout << "- " << heuristicName(static_cast<Heuristic>(h)) << " shifts (distance:count):";
+        for (int d = 0; d < (int)histogram.size(); d++) {
+            if (histogram[d] > 0) std::cout << " " << d << ":" << histogram[d];
+            shifts += histogram[d];
+        }
+        if (histogram.size() > 1) unitShifts += histogram[1];
+        std::cout << std::endl;
+    }
+    std::cout << "- Unit shifts: " << unitShifts << " of " << shifts;
+    if (shifts > 0) std::cout << " (" << (100.0 * unitShifts / shifts) << "%)";
+    std::cout << std::endl;
 }
 
 void printPatternAlignment(const std::string& pattern, const std::string& text, int shift) {
@@ -52,6 +194,28 @@ void precomputeBadCharacterTable(const std::string& pattern, std::vector<int>& b
     }
 }
 
+/**
+* Re-preprocesses a bad character table that currently holds `previousPattern` so that
+* it holds `pattern`. Only the entries of characters in the previous pattern are reset
+* before the new pattern's characters are recorded, so switching between short patterns
+* costs O(m) instead of re-initializing all NUM_CHARS entries.
+*
+* @param previousPattern The pattern the table was last built for
+* @param pattern The new pattern
+* @param badCharTable A table built by `precomputeBadCharacterTable` for `previousPattern`
+*/
+void updateBadCharacterTable(const std::string& previousPattern, const std::string& pattern,
+                             std::vector<int>& badCharTable) {
+    if ((int)badCharTable.size() != NUM_CHARS) {
+        precomputeBadCharacterTable(pattern, badCharTable);
+        return;
+    }
+    for (char c : previousPattern) badCharTable[(unsigned char)c] = -1;
+    for (int i = 0; i < (int)pattern.length(); ++i) {
+        badCharTable[(unsigned char)pattern[i]] = i;
+    }
+}
+
 /**
 * Preprocesses the pattern to create the good suffix heuristic table
 * The good suffix rule is applied when a mismatch occurs after a suffix of the pattern
@@ -64,17 +228,23 @@ void precomputeBadCharacterTable(const std::string& pattern, std::vector<int>& b
 * of the good suffix, and shift to align them. If no such prefix exists, shift the pattern
 * completely.
 *
-* @param pattern The string pattern to be searched for
+* The table only compares symbols for equality, so any sequence type works as the pattern.
+*
+* @param pattern The string (or other sequence) pattern to be searched for
 * @param goodsuffixShifts A reference to a vector that will store the precomputed shift values.
 * `goodSuffixShifts[k]` stores the shift distance for a good suffix of length `m-k`.
+* @param borderPos Working storage; passing the same vector again avoids reallocating it
+* @param equal Equality of two pattern symbols
 */
-void precomputeGoodSuffixTable(const std::string& pattern, std::vector<int>& goodSuffixShifts) {
-    int m = pattern.length();
+template <typename Sequence, typename Equal = std::equal_to<>>
+void precomputeGoodSuffixTable(const Sequence& pattern, std::vector<int>& goodSuffixShifts,
+                               std::vector<int>& borderPos, Equal equal = Equal()) {
+    int m = pattern.size();
     goodSuffixShifts.assign(m + 1, 0);
 
     // `borderPos` stores the starting posistion of the widest border of each suffix of the pattern.
     // A "border" is a substring that is both a proper prefix and a proper suffix
-    std::vector<int> borderPos(m + 1);
+    borderPos.resize(m + 1);
 
     int i = m;
     int j = m + 1;
@@ -85,7 +255,7 @@ void precomputeGoodSuffixTable(const std::string& pattern, std::vector<int>& goo
 
         // Move j back until characters at pattern[i-1] & pattern[j-1] match
         // or until j moves past the end (j >m)
-        while (j <= m && pattern[i - 1] != pattern[j - 1]) {
+        while (j <= m && !equal(pattern[i - 1], pattern[j - 1])) {
             // set it to the distance needed to align the next possible good suffix
             // when goodSuffixShifts at position j has not been set
             if (goodSuffixShifts[j] == 0) {
@@ -113,19 +283,29 @@ void precomputeGoodSuffixTable(const std::string& pattern, std::vector<int>& goo
     }
 }
 
+// As above, with working storage of its own
+template <typename Sequence, typename Equal = std::equal_to<>>
+void precomputeGoodSuffixTable(const Sequence& pattern, std::vector<int>& goodSuffixShifts, Equal equal = Equal()) {
+    std::vector<int> borderPos;
+    precomputeGoodSuffixTable(pattern, goodSuffixShifts, borderPos, equal);
+}
+
 /**
 * Searches for a pattern within a text using the Boyer-Moore algorithm
 *
 * @param text The text to be searched
 * @param pattern The pattern to be searched for in the text
+* @param stats Optional counters filled in during the search
+* @param verbose Prints every alignment step and the summary when true
 */
-void searchBoyerMoore(const std::string& text, const std::string& pattern) {
+void searchBoyerMoore(const std::string& text, const std::string& pattern,
+                      SearchStats* stats = nullptr, bool verbose = true) {
     int n = text.length(); // length of the text
     int m = pattern.length(); // length of the pattern
 
     // Edge case: if pattern is empty or longer than the text, no possible match
     if (m == 0 || n < m) {
-        std::cout << "Pattern is empty or longer than the text." << std::endl;
+        if (verbose) std::cout << "Pattern is empty or longer than the text." << std::endl;
         return;
     }
 
@@ -145,31 +325,40 @@ void searchBoyerMoore(const std::string& text, const std::string& pattern) {
     bool found = false;         // Flag to indicate if a match has been found
     int totalSkippedChars = 0;  // Total number of characters skipped through shifting
     int step = 1;               // Step counter for display output
+    SearchStats localStats;     // Used when the caller does not ask for stats
+    if (stats == nullptr) stats = &localStats;
+    std::vector<bool> inspected(n, false);  // Text positions compared at least once
 
     // Loop until pattern exceeds the remaining text
     while (shift <= (n - m)) {
-        printAlignmentStep(step, shift); // Print current alignment at the current step
+        if (verbose) printAlignmentStep(step, shift); // Print current alignment at the current step
+        stats->alignments++;
         int j = m - 1;                   // Start comparing from end of pattern
         int comparisonsThisStep = 0;     // Comparisons done in the current step
 
         // Compare pattern and text from right to left
         while (j >= 0) {
+               comparisonsThisStep++;
+               inspected[shift + j] = true;
                if (pattern[j] == text[shift + j]) {
                 j--;    // If characters match, move one position left
                } else {
                 break;  // Exit when mismatch found
                }
         }
+        stats->comparisons += comparisonsThisStep;
 
         // If j < 0 meaning a full match was found at current step
         if (j < 0) {
             matchedIndex.push_back(shift);  // Record the match position
-            std::cout << "Pattern found at index: " << shift << std::endl;
+            if (verbose) std::cout << "Pattern found at index: " << shift << std::endl;
 
             // Shift pattern using the Good suffix rule for a full match
             int finalShift = goodSuffixShifts[0];
-            if (finalShift + shift <= (n-m))
-              std::cout << "- Shifting right by: " << finalShift << "      - Chosen Heuristic: Good Suffix" << std::endl;
+            if (verbose && finalShift + shift <= (n-m))
+              std::cout << "- Shifting right by: " << finalShift << "      - Chosen Heuristic: "
+                        << heuristicName(Heuristic::GoodSuffix) << std::endl;
+            recordShift(*stats, Heuristic::GoodSuffix, finalShift);
 
             shift += finalShift;  // Apply the shift
             if (finalShift > 1 && shift <= (n-m)) totalSkippedChars += finalShift - 1;  // Compute the skipped characters
@@ -187,21 +376,28 @@ void searchBoyerMoore(const std::string& text, const std::string& pattern) {
             // Compute the number of shifts based on the current mismatched position using Good Suffix Table
             int goodSuffixShift = goodSuffixShifts[j + 1];
 
-            // Take the largest shift among the two result
-            int finalShift = std::max(badCharShift, goodSuffixShift);
-
-            // Determine which heuristice was chosen for the current step
-            std::string heuristic = (badCharShift >= goodSuffixShift) ? "Bad Character" : "Good Suffix";
+            // Take the largest shift among the two result and record which heuristic won
+            ShiftEvent event;
+            event.badCharShift = badCharShift;
+            event.goodSuffixShift = goodSuffixShift;
+            event.heuristic = (badCharShift >= goodSuffixShift) ? Heuristic::BadCharacter : Heuristic::GoodSuffix;
+            event.shiftAmount = std::max(badCharShift, goodSuffixShift);
+            recordShift(*stats, event.heuristic, event.shiftAmount);
 
-            printShiftDetails(badCharShift, goodSuffixShift, heuristic, finalShift);
+            if (verbose) printShiftDetails(event);
+            int finalShift = event.shiftAmount;
             shift += finalShift; // Apply the chosen shift
             if (finalShift > 1 && shift <= (n-m)) totalSkippedChars += finalShift - 1;
             step++;
         }
-        if (shift <= (n - m))
+        if (verbose && shift <= (n - m))
           printPatternAlignment(pattern, text, shift);
     }
 
+    stats->textBytes += n;
+    stats->inspectedBytes += std::count(inspected.begin(), inspected.end(), true);
+    if (!verbose) return;
+
     if (!found) {
         std::cout << "Pattern not found in the text." << std::endl;
     }
@@ -209,16 +405,3791 @@ void searchBoyerMoore(const std::string& text, const std::string& pattern) {
     // Final results summary
     std::cout << "\n================================================" << std::endl;
     std::cout << "The pattern matched the text at index: ";
-    for (int i = 0; i < matchedIndex.size(); i++) {
+    for (int i = 0; i < (int)matchedIndex.size(); i++) {
         std::cout << matchedIndex[i] << " ";
     }
     std::cout << "\nTotal Skipped Characters: " << totalSkippedChars << std::endl;
+    printHeuristicRatios(*stats);
+    printSearchReport("pattern \"" + pattern + "\"", *stats);
 }
 
-// ============================================================
-// Main Program Entry Point
-// ============================================================
-int main() {
+/**
+* Runs every pattern over every text of a corpus without the step-by-step output
+* and prints one skip-efficiency report per pattern followed by one for the whole corpus.
+*
+* @param corpus The texts to be searched
+* @param patterns The patterns to be searched for in each text
+*/
+void reportCorpus(const std::vector<std::string>& corpus, const std::vector<std::string>& patterns) {
+    SearchStats corpusStats;
+    for (const std::string& pattern : patterns) {
+        SearchStats patternStats;
+        for (const std::string& text : corpus) {
+            searchBoyerMoore(text, pattern, &patternStats, false);
+        }
+        printSearchReport("pattern \"" + pattern + "\"", patternStats);
+        mergeSearchStats(corpusStats, patternStats);
+    }
+    printSearchReport("corpus", corpusStats);
+}
+
+// =========================
+// Compiled Patterns and Search Engine
+// =========================
+
+/**
+* A pattern together with its preprocessed heuristic tables. Compiling once and
+* reusing the result avoids re-running the preprocessing for every search.
+*/
+struct CompiledPattern {
+    std::string pattern;
+    std::vector<int> badCharTable;
+    std::vector<int> goodSuffixShifts;
+    std::vector<int> borderScratch;  // Working storage for `recompilePattern`; not part of the tables
+};
+
+CompiledPattern compilePattern(const std::string& pattern) {
+    CompiledPattern compiled;
+    compiled.pattern = pattern;
+    precomputeBadCharacterTable(pattern, compiled.badCharTable);
+    precomputeGoodSuffixTable(pattern, compiled.goodSuffixShifts, compiled.borderScratch);
+    return compiled;
+}
+
+/**
+* Reuses `compiled` (its tables and working storage) for a new pattern; see
+* `updateBadCharacterTable`. Switching to a pattern no longer than any compiled into
+* it before allocates nothing.
+*/
+void recompilePattern(CompiledPattern& compiled, const std::string& pattern) {
+    updateBadCharacterTable(compiled.pattern, pattern, compiled.badCharTable);
+    precomputeGoodSuffixTable(pattern, compiled.goodSuffixShifts, compiled.borderScratch);
+    compiled.pattern = pattern;
+}
+
+/**
+* The Boyer-Moore loop of `searchBoyerMoore` without any printing or instrumentation.
+* Alignments from `shift` up to and including `lastShift` are tried and `onMatch(offset)`
+* is called for every match. The caller must ensure `lastShift + m` does not exceed
+* the length of the text.
+*
+* @param text Pointer to the text to be searched
+* @param compiled The compiled pattern (must not be empty)
+* @param shift First alignment to try
+* @param lastShift Last alignment to try
+* @param onMatch Called with the starting offset of each match
+* @return The next alignment that would have been tried, which is always past `lastShift`
+*/
+template <typename OnMatch>
+std::size_t scanBoyerMoore(const char* text, const CompiledPattern& compiled,
+                           std::size_t shift, std::size_t lastShift, OnMatch&& onMatch) {
+    const char* pattern = compiled.pattern.data();
+    const int m = compiled.pattern.length();
+    const int* badCharTable = compiled.badCharTable.data();
+    const int* goodSuffixShifts = compiled.goodSuffixShifts.data();
+
+    while (shift <= lastShift) {
+        int j = m - 1;
+        while (j >= 0 && pattern[j] == text[shift + j]) j--;
+
+        if (j < 0) {
+            onMatch(shift);
+            shift += goodSuffixShifts[0];
+        } else {
+            int badCharShift = j - badCharTable[(unsigned char)text[shift + j]];
+            shift += std::max(badCharShift, goodSuffixShifts[j + 1]);
+        }
+    }
+    return shift;
+}
+
+// Confirms a candidate alignment; shared by every kernel that filters candidates first
+inline bool verifyMatch(const char* candidate, const char* pattern, std::size_t m) {
+    return std::memcmp(candidate, pattern, m) == 0;
+}
+
+// =========================
+// SWAR Kernel for Short Patterns
+// =========================
+//
+// Portable 64-bit "SIMD within a register" kernel for patterns of up to 8 bytes, for
+// builds without vector instructions. Eight alignments are tested per step: the first
+// and last pattern bytes are compared against eight text bytes each with one xor, and
+// zero bytes of the results mark the candidate alignments.
+
+const int SWAR_MAX_PATTERN = 8;
+const uint64_t SWAR_ONES = 0x0101010101010101ULL;
+const uint64_t SWAR_LOW7 = 0x7f7f7f7f7f7f7f7fULL;
+
+// Loads 8 bytes so that text[p + k] is byte k (bits 8k..8k+7) on every platform
+uint64_t loadWord(const char* p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// Sets the high bit of exactly those bytes of `word` that are zero
+uint64_t zeroByteMask(uint64_t word) {
+    return ~(((word & SWAR_LOW7) + SWAR_LOW7) | word | SWAR_LOW7);
+}
+
+/**
+* Same contract as `scanBoyerMoore`, for patterns of 1 to SWAR_MAX_PATTERN bytes.
+* A candidate is confirmed by comparing one masked word holding the whole pattern.
+*/
+template <typename OnMatch>
+std::size_t scanSwar(const char* text, const CompiledPattern& compiled,
+                     std::size_t shift, std::size_t lastShift, OnMatch&& onMatch) {
+    const std::string& pattern = compiled.pattern;
+    const std::size_t m = pattern.length();
+    const std::size_t end = lastShift + m;  // Text bytes the caller allows us to read
+
+    uint64_t patternWord = 0;
+    for (std::size_t k = 0; k < m; k++) patternWord |= uint64_t((unsigned char)pattern[k]) << (8 * k);
+    const uint64_t patternMask = (m == 8) ? ~uint64_t(0) : (uint64_t(1) << (8 * m)) - 1;
+    const uint64_t firstBytes = SWAR_ONES * (unsigned char)pattern[0];
+    const uint64_t lastBytes = SWAR_ONES * (unsigned char)pattern[m - 1];
+
+    // Blocks of 8 alignments while both the block and every candidate's word are in bounds
+    while (shift <= lastShift && shift + 16 <= end) {
+        uint64_t candidates = zeroByteMask(loadWord(text + shift) ^ firstBytes) &
+                              zeroByteMask(loadWord(text + shift + m - 1) ^ lastBytes);
+        while (candidates != 0) {
+            std::size_t candidate = shift + __builtin_ctzll(candidates) / 8;
+            if (candidate > lastShift) break;
+            if (((loadWord(text + candidate) ^ patternWord) & patternMask) == 0) onMatch(candidate);
+            candidates &= candidates - 1;
+        }
+        shift += 8;
+    }
+
+    for (; shift <= lastShift; shift++) {
+        if (verifyMatch(text + shift, pattern.data(), m)) onMatch(shift);
+    }
+    return shift;
+}
+
+// =========================
+// Vector Kernels and CPU Dispatch
+// =========================
+//
+// Every kernel below is compiled into the same binary; on x86 the SSE4.2, AVX2 and
+// AVX-512BW versions are built with per-function target attributes, so the binary still
+// runs on machines without them. `activeKernel()` picks the widest one the CPU supports
+// once, and BM_FORCE_KERNEL (or --kernel=<name>) overrides the choice for benchmarking.
+//
+// The vector kernels filter alignments on a few pattern bytes and confirm each candidate
+// with memcmp, which is O(nm) when the filter passes almost every alignment (`a{4000}ba{4000}`
+// in a run of `a`). They leave long patterns, and texts where false candidates pile up,
+// to the Boyer-Moore loop.
+
+// A kernel appends the offsets of matches at alignments shift..lastShift to `matches`
+typedef void (*SearchKernel)(const char* text, const CompiledPattern& compiled,
+                             std::size_t shift, std::size_t lastShift, std::vector<std::size_t>& matches);
+
+enum class KernelIsa { Generic, Sse42, Avx2, Avx512 };
+const int NUM_KERNELS = 4;
+
+const char* kernelName(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::Generic: return "generic";
+        case KernelIsa::Sse42: return "sse4.2";
+        case KernelIsa::Avx2: return "avx2";
+        case KernelIsa::Avx512: return "avx512";
+    }
+    return "";
+}
+
+// Longer patterns skip the vector kernels: past about 1 KiB the Boyer-Moore loop's shifts
+// beat 32 or 64 alignments per step even on random text
+const std::size_t VECTOR_KERNEL_MAX_PATTERN = 512;
+
+// Memcmp bytes a vector kernel may spend on false candidates before giving up on its
+// filter: a fixed allowance plus a share of each alignment it has covered
+const std::size_t FALSE_CANDIDATE_BYTES = 1u << 20;
+const std::size_t FALSE_CANDIDATE_BYTES_PER_ALIGNMENT = 16;
+
+/**
+* Tracks the cost of the false candidates a vector kernel has confirmed since `start`,
+* counting each as a full comparison of the pattern.
+*/
+struct CandidateBudget {
+    std::size_t start;
+    std::size_t patternLength;
+    std::size_t spent = 0;
+
+    CandidateBudget(std::size_t start, std::size_t patternLength) : start(start), patternLength(patternLength) {}
+
+    // Charges one false candidate at `candidate`; true once the budget is used up
+    bool exhausted(std::size_t candidate) {
+        spent += patternLength;
+        return spent > FALSE_CANDIDATE_BYTES + (candidate - start) * FALSE_CANDIDATE_BYTES_PER_ALIGNMENT;
+    }
+};
+
+// Appends the matches at alignments shift..lastShift found by the Boyer-Moore loop
+void appendBoyerMooreMatches(const char* text, const CompiledPattern& compiled,
+                             std::size_t shift, std::size_t lastShift, std::vector<std::size_t>& matches) {
+    if (shift > lastShift) return;
+    scanBoyerMoore(text, compiled, shift, lastShift, [&](std::size_t offset) { matches.push_back(offset); });
+}
+
+// Scalar kernel: SWAR for short patterns, the Boyer-Moore loop otherwise
+void searchGenericKernel(const char* text, const CompiledPattern& compiled,
+                         std::size_t shift, std::size_t lastShift, std::vector<std::size_t>& matches) {
+    auto onMatch = [&](std::size_t offset) { matches.push_back(offset); };
+    if (compiled.pattern.length() <= (std::size_t)SWAR_MAX_PATTERN) {
+        scanSwar(text, compiled, shift, lastShift, onMatch);
+    } else {
+        scanBoyerMoore(text, compiled, shift, lastShift, onMatch);
+    }
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BM_X86_KERNELS 1
+
+/**
+* SSE4.2 kernel: `pcmpestri` in equal-ordered mode finds the first position of each
+* 16-byte block where the pattern (at most its first 16 bytes) starts, including a
+* partial occurrence running off the end of the block; candidates are confirmed with memcmp.
+*/
+__attribute__((target("sse4.2")))
+void searchSse42Kernel(const char* text, const CompiledPattern& compiled,
+                       std::size_t shift, std::size_t lastShift, std::vector<std::size_t>& matches) {
+    const char* pattern = compiled.pattern.data();
+    const std::size_t m = compiled.pattern.length();
+    if (m > VECTOR_KERNEL_MAX_PATTERN) return appendBoyerMooreMatches(text, compiled, shift, lastShift, matches);
+    const std::size_t end = lastShift + m;
+    CandidateBudget budget(shift, m);
+    const int needleLength = std::min<std::size_t>(m, 16);
+    char needleBytes[16] = {};
+    std::memcpy(needleBytes, pattern, needleLength);
+    const __m128i needle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(needleBytes));
+
+    while (shift <= lastShift && shift + 16 <= end) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + shift));
+        int index = _mm_cmpestri(needle, needleLength, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ORDERED);
+        if (index == 16) {
+            shift += 16;
+            continue;
+        }
+        std::size_t candidate = shift + index;
+        if (candidate > lastShift) break;
+        if (verifyMatch(text + candidate, pattern, m)) {
+            matches.push_back(candidate);
+        } else if (budget.exhausted(candidate)) {
+            return appendBoyerMooreMatches(text, compiled, candidate + 1, lastShift, matches);
+        }
+        shift = candidate + 1;
+    }
+    for (; shift <= lastShift; shift++) {
+        if (verifyMatch(text + shift, pattern, m)) matches.push_back(shift);
+    }
+}
+
+/**
+* AVX2 kernel: 32 alignments per step. The first and last pattern bytes are compared
+* against 32 text bytes each and the alignments where both agree are confirmed with memcmp.
+*/
+__attribute__((target("avx2")))
+void searchAvx2Kernel(const char* text, const CompiledPattern& compiled,
+                      std::size_t shift, std::size_t lastShift, std::vector<std::size_t>& matches) {
+    const char* pattern = compiled.pattern.data();
+    const std::size_t m = compiled.pattern.length();
+    if (m > VECTOR_KERNEL_MAX_PATTERN) return appendBoyerMooreMatches(text, compiled, shift, lastShift, matches);
+    const std::size_t end = lastShift + m;
+    CandidateBudget budget(shift, m);
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[m - 1]);
+
+    while (shift <= lastShift && shift + m - 1 + 32 <= end) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + shift));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + shift + m - 1));
+        uint32_t candidates = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+        while (candidates != 0) {
+            std::size_t candidate = shift + __builtin_ctz(candidates);
+            if (candidate > lastShift) break;
+            if (verifyMatch(text + candidate, pattern, m)) {
+                matches.push_back(candidate);
+            } else if (budget.exhausted(candidate)) {
+                return appendBoyerMooreMatches(text, compiled, candidate + 1, lastShift, matches);
+            }
+            candidates &= candidates - 1;
+        }
+        shift += 32;
+    }
+    for (; shift <= lastShift; shift++) {
+        if (verifyMatch(text + shift, pattern, m)) matches.push_back(shift);
+    }
+}
+
+// AVX-512BW kernel: the AVX2 approach with 64 alignments per step and mask registers
+__attribute__((target("avx512f,avx512bw")))
+void searchAvx512Kernel(const char* text, const CompiledPattern& compiled,
+                        std::size_t shift, std::size_t lastShift, std::vector<std::size_t>& matches) {
+    const char* pattern = compiled.pattern.data();
+    const std::size_t m = compiled.pattern.length();
+    if (m > VECTOR_KERNEL_MAX_PATTERN) return appendBoyerMooreMatches(text, compiled, shift, lastShift, matches);
+    const std::size_t end = lastShift + m;
+    CandidateBudget budget(shift, m);
+    const __m512i first = _mm512_set1_epi8(pattern[0]);
+    const __m512i last = _mm512_set1_epi8(pattern[m - 1]);
+
+    while (shift <= lastShift && shift + m - 1 + 64 <= end) {
+        __m512i blockFirst = _mm512_loadu_si512(text + shift);
+        __m512i blockLast = _mm512_loadu_si512(text + shift + m - 1);
+        uint64_t candidates = _mm512_cmpeq_epi8_mask(blockFirst, first) & _mm512_cmpeq_epi8_mask(blockLast, last);
+        while (candidates != 0) {
+            std::size_t candidate = shift + __builtin_ctzll(candidates);
+            if (candidate > lastShift) break;
+            if (verifyMatch(text + candidate, pattern, m)) {
+                matches.push_back(candidate);
+            } else if (budget.exhausted(candidate)) {
+                return appendBoyerMooreMatches(text, compiled, candidate + 1, lastShift, matches);
+            }
+            candidates &= candidates - 1;
+        }
+        shift += 64;
+    }
+    for (; shift <= lastShift; shift++) {
+        if (verifyMatch(text + shift, pattern, m)) matches.push_back(shift);
+    }
+}
+
+#endif // x86 kernels
+
+bool kernelSupported(KernelIsa isa) {
+#ifdef BM_X86_KERNELS
+    switch (isa) {
+        case KernelIsa::Generic: return true;
+        case KernelIsa::Sse42: return __builtin_cpu_supports("sse4.2");
+        case KernelIsa::Avx2: return __builtin_cpu_supports("avx2");
+        case KernelIsa::Avx512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+    return false;
+#else
+    return isa == KernelIsa::Generic;
+#endif
+}
+
+SearchKernel kernelFunction(KernelIsa isa) {
+#ifdef BM_X86_KERNELS
+    switch (isa) {
+        case KernelIsa::Sse42: return searchSse42Kernel;
+        case KernelIsa::Avx2: return searchAvx2Kernel;
+        case KernelIsa::Avx512: return searchAvx512Kernel;
+        case KernelIsa::Generic: break;
+    }
+#endif
+    (void)isa;
+    return searchGenericKernel;
+}
+
+KernelIsa forcedKernel = KernelIsa::Generic;
+bool kernelForced = false;
+std::atomic<bool> kernelSelected(false);  // Set once `activeKernelIsa` has made its choice
+
+/**
+* Forces the kernel used by `findMatches`, e.g. to benchmark one ISA against another.
+* Only takes effect before the first search, which fixes the choice for the process.
+*
+* @return false when the name is unknown, the CPU does not support that kernel, or the
+*         kernel has already been selected
+*/
+bool forceKernel(const std::string& name) {
+    if (kernelSelected) return false;
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        KernelIsa isa = static_cast<KernelIsa>(k);
+        if (name == kernelName(isa)) {
+            if (!kernelSupported(isa)) return false;
+            forcedKernel = isa;
+            kernelForced = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The kernel chosen for this process: the forced one, or else the widest supported one
+KernelIsa activeKernelIsa() {
+    static const KernelIsa isa = []() {
+        const char* requested = std::getenv("BM_FORCE_KERNEL");
+        if (!kernelForced && requested != nullptr && !forceKernel(requested)) {
+            std::cerr << "BM_FORCE_KERNEL=" << requested << " is not available; using cpuid" << std::endl;
+        }
+        kernelSelected = true;
+        if (kernelForced) return forcedKernel;
+        for (int k = NUM_KERNELS - 1; k > 0; k--) {
+            if (kernelSupported(static_cast<KernelIsa>(k))) return static_cast<KernelIsa>(k);
+        }
+        return KernelIsa::Generic;
+    }();
+    return isa;
+}
+
+SearchKernel activeKernel() {
+    static const SearchKernel kernel = kernelFunction(activeKernelIsa());
+    return kernel;
+}
+
+/**
+* Returns the starting offsets of every occurrence of a compiled pattern in a text,
+* using the kernel selected for this CPU (see `activeKernel`).
+*/
+std::vector<std::size_t> findMatches(const char* text, std::size_t n, const CompiledPattern& compiled) {
+    std::vector<std::size_t> matches;
+    std::size_t m = compiled.pattern.length();
+    if (m == 0 || n < m) return matches;
+    activeKernel()(text, compiled, 0, n - m, matches);
+    return matches;
+}
+
+/**
+* Times every kernel this CPU supports on 64 MiB of random lowercase text.
+*/
+int benchmarkKernels() {
+    std::string text(64u << 20, ' ');
+    uint32_t state = 12345;
+    for (char& c : text) {
+        state = state * 1103515245 + 12345;
+        c = 'a' + (state >> 16) % 26;
+    }
+
+    std::cout << "Active kernel: " << kernelName(activeKernelIsa()) << std::endl;
+    for (const std::string pattern : {"ab", "hello", "abcdefghijk", "the quick brown fox jumps"}) {
+        CompiledPattern compiled = compilePattern(pattern);
+        std::cout << "Pattern \"" << pattern << "\":";
+        for (int k = 0; k < NUM_KERNELS; k++) {
+            KernelIsa isa = static_cast<KernelIsa>(k);
+            if (!kernelSupported(isa)) continue;
+            std::vector<std::size_t> matches;
+            auto start = std::chrono::steady_clock::now();
+            kernelFunction(isa)(text.data(), compiled, 0, text.size() - pattern.length(), matches);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "      - " << kernelName(isa) << ": " << ms << " ms (" << matches.size() << ")";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+/**
+* Microbenchmark for workloads that switch patterns constantly: each iteration prepares
+* one of a set of short patterns and searches a short message with it. Compares a fresh
+* `compilePattern`, reusing the tables with a full bad character reset, and `recompilePattern`.
+* The last two share the good suffix working storage, so they differ only in the bad
+* character reset. Preparation is timed on its own, then together with the search.
+*/
+int benchmarkPatternSwitch() {
+    const int iterations = 2000000;
+    const std::vector<std::string> patterns = {"GET ", "POST", "HTTP/1.1", "Host:", "ERR", "id=", "\r\n\r\n", "token"};
+    const std::string message = "POST /api/v1/items?id=42 HTTP/1.1\r\nHost: example\r\nContent-Length: 0\r\n\r\n";
+    std::size_t n = message.length();
+
+    auto run = [&](const char* label, auto&& prepare) {
+        CompiledPattern compiled = compilePattern(patterns[0]);
+        std::size_t checksum = 0;  // Keeps the preparation-only loop from being optimized away
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            prepare(compiled, patterns[i % patterns.size()]);
+            checksum += compiled.goodSuffixShifts[0] + compiled.badCharTable[(unsigned char)message[i % n]];
+        }
+        double prepareNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        std::size_t matches = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            const std::string& pattern = patterns[i % patterns.size()];
+            prepare(compiled, pattern);
+            scanBoyerMoore(message.data(), compiled, 0, n - pattern.length(), [&](std::size_t) { matches++; });
+        }
+        double totalNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << label << ": " << prepareNs / iterations << " ns to prepare, " << totalNs / iterations
+                  << " ns with the search (" << matches << " matches, checksum " << checksum << ")" << std::endl;
+    };
+
+    std::cout << "Pattern switches: " << iterations << std::endl;
+    run("compilePattern", [](CompiledPattern& compiled, const std::string& pattern) {
+        compiled = compilePattern(pattern);
+    });
+    run("Full table reset", [](CompiledPattern& compiled, const std::string& pattern) {
+        compiled.pattern = pattern;
+        precomputeBadCharacterTable(pattern, compiled.badCharTable);
+        precomputeGoodSuffixTable(pattern, compiled.goodSuffixShifts, compiled.borderScratch);
+    });
+    run("recompilePattern", [](CompiledPattern& compiled, const std::string& pattern) {
+        recompilePattern(compiled, pattern);
+    });
+    return 0;
+}
+
+// =========================
+// Engine Variants
+// =========================
+
+/**
+* Turbo-BM: the Boyer-Moore loop plus a memory of the factor of the text that matched
+* the pattern at the previous alignment. When the previous shift came from the Good
+* Suffix rule, the `memory` characters aligned with that factor are known to match and
+* are jumped over instead of compared again, and after a mismatch a "turbo shift" may be
+* taken when the current match is shorter than the remembered one. Uses the same tables
+* as `scanBoyerMoore` plus O(1) extra state, and does at most 2n comparisons.
+*
+* @param text Pointer to the text to be searched
+* @param n Length of the text
+* @param compiled The compiled pattern (must not be empty)
+* @param onMatch Called with the starting offset of each match
+*/
+template <typename OnMatch>
+void scanTurboBoyerMoore(const char* text, std::size_t n, const CompiledPattern& compiled, OnMatch&& onMatch) {
+    const char* pattern = compiled.pattern.data();
+    const int m = compiled.pattern.length();
+    const std::vector<int>& badCharTable = compiled.badCharTable;
+    const std::vector<int>& goodSuffixShifts = compiled.goodSuffixShifts;
+    if (m == 0 || n < (std::size_t)m) return;
+
+    std::size_t shift = 0;
+    int memory = 0;                // Length of the factor remembered from the previous alignment
+    int lastShift = m;             // Distance of the previous shift
+    bool memoryFromMatch = false;  // The remembered factor is the border left by a full match
+
+    while (shift <= n - m) {
+        int j = m - 1;
+        while (j >= 0 && pattern[j] == text[shift + j]) {
+            j--;
+            // Jump over the remembered factor, which ends where the old window's suffix did
+            if (memory != 0 && j == m - 1 - lastShift) j -= memory;
+        }
+
+        if (j < 0) {
+            onMatch(shift);
+            lastShift = goodSuffixShifts[0];
+            memory = m - lastShift;
+            memoryFromMatch = true;
+        } else {
+            int matched = m - 1 - j;
+            int turboShift = memory - matched;
+            int badCharShift = j - badCharTable[(unsigned char)text[shift + j]];
+            int goodSuffixShift = goodSuffixShifts[j + 1];
+
+            lastShift = std::max(std::max(turboShift, badCharShift), goodSuffixShift);
+            if (lastShift == goodSuffixShift) {
+                memory = std::min(m - lastShift, matched);
+                memoryFromMatch = false;
+            } else {
+                // The "shift past the memory" rule only holds for a factor left by a Good Suffix
+                // shift; applied to the border of a full match it can skip an occurrence
+                if (turboShift < badCharShift && !memoryFromMatch) lastShift = std::max(lastShift, memory + 1);
+                memory = 0;
+            }
+        }
+        shift += lastShift;
+    }
+}
+
+std::vector<std::size_t> findMatchesTurbo(const char* text, std::size_t n, const CompiledPattern& compiled) {
+    std::vector<std::size_t> matches;
+    scanTurboBoyerMoore(text, n, compiled, [&](std::size_t offset) { matches.push_back(offset); });
+    return matches;
+}
+
+/**
+* Preprocesses the pattern for the Apostolico-Giancarlo engine.
+* `suffixLengths[i]` is the length of the longest substring ending at position `i`
+* that is also a suffix of the whole pattern (so `suffixLengths[m-1] = m`).
+*
+* @param pattern The string pattern to be searched for
+* @param suffixLengths A reference to a vector that will store the lengths
+*/
+void precomputeSuffixLengths(const std::string& pattern, std::vector<int>& suffixLengths) {
+    int m = pattern.length();
+    suffixLengths.assign(m, 0);
+    if (m == 0) return;
+    suffixLengths[m - 1] = m;
+
+    // [g+1, f] is the rightmost window known to match a suffix of the pattern
+    int f = m - 1;
+    int g = m - 1;
+    for (int i = m - 2; i >= 0; --i) {
+        if (i > g && suffixLengths[i + m - 1 - f] < i - g) {
+            suffixLengths[i] = suffixLengths[i + m - 1 - f];
+        } else {
+            if (i < g) g = i;
+            f = i;
+            while (g >= 0 && pattern[g] == pattern[g + m - 1 - f]) --g;
+            suffixLengths[i] = f - g;
+        }
+    }
+}
+
+/**
+* Apostolico-Giancarlo: the Boyer-Moore loop plus, for every text position, the length
+* of the pattern suffix that was found to match ending there. When the right-to-left
+* compare reaches such a position the recorded length is combined with `suffixLengths`
+* to jump over the whole span, or to conclude a mismatch or a match, without comparing
+* it again. At most 1.5n comparisons. Only positions inside the current window can be
+* revisited, so the per-position lengths live in a ring of the next power of two >= m.
+*
+* @param text Pointer to the text to be searched
+* @param n Length of the text
+* @param compiled The compiled pattern (must not be empty)
+* @param suffixLengths Output of `precomputeSuffixLengths` for the same pattern
+* @param onMatch Called with the starting offset of each match
+*/
+template <typename OnMatch>
+void scanApostolicoGiancarlo(const char* text, std::size_t n, const CompiledPattern& compiled,
+                             const std::vector<int>& suffixLengths, OnMatch&& onMatch) {
+    const char* pattern = compiled.pattern.data();
+    const int m = compiled.pattern.length();
+    const std::vector<int>& badCharTable = compiled.badCharTable;
+    const std::vector<int>& goodSuffixShifts = compiled.goodSuffixShifts;
+    if (m == 0 || n < (std::size_t)m) return;
+
+    std::size_t ringSize = 1;
+    while (ringSize < (std::size_t)m) ringSize <<= 1;
+    const std::size_t mask = ringSize - 1;
+    std::vector<int> skip(ringSize, 0);  // skip[pos & mask]: suffix length matched ending at text position pos
+
+    std::size_t shift = 0;
+    while (shift <= n - m) {
+        int j = m - 1;
+        while (j >= 0) {
+            int known = skip[(shift + j) & mask];
+            int suffix = suffixLengths[j];
+            if (known == 0) {
+                if (pattern[j] != text[shift + j]) break;
+                j--;
+            } else if (known > suffix) {
+                // The text matches more of the pattern suffix than x[..j] does: mismatch `suffix` further left
+                j = (j + 1 == suffix) ? -1 : j - suffix;
+                break;
+            } else {
+                j -= known;
+                if (known < suffix) break;  // Text and x[..j] diverge right after the known span
+            }
+        }
+
+        int finalShift;
+        if (j < 0) {
+            onMatch(shift);
+            skip[(shift + m - 1) & mask] = m;
+            finalShift = goodSuffixShifts[0];
+        } else {
+            skip[(shift + m - 1) & mask] = m - 1 - j;
+            int badCharShift = j - badCharTable[(unsigned char)text[shift + j]];
+            finalShift = std::max(badCharShift, goodSuffixShifts[j + 1]);
+        }
+
+        // Positions entering the window reuse the slots of positions that left it
+        std::size_t entering = std::min<std::size_t>(finalShift, ringSize);
+        for (std::size_t k = 0; k < entering; k++) skip[(shift + m + k) & mask] = 0;
+        shift += finalShift;
+    }
+}
+
+std::vector<std::size_t> findMatchesApostolicoGiancarlo(const char* text, std::size_t n, const CompiledPattern& compiled) {
+    std::vector<std::size_t> matches;
+    std::vector<int> suffixLengths;
+    precomputeSuffixLengths(compiled.pattern, suffixLengths);
+    scanApostolicoGiancarlo(text, n, compiled, suffixLengths, [&](std::size_t offset) { matches.push_back(offset); });
+    return matches;
+}
+
+/**
+* Critical factorization of a pattern for the Two-Way algorithm. Only a pointer to the
+* pattern and a few integers are kept, so searching needs O(1) memory beyond the pattern.
+*/
+struct TwoWayPattern {
+    const char* pattern = nullptr;  // Not owned; must outlive every search
+    std::size_t length = 0;
+    long criticalPos = -1;          // The pattern is split as x[0..criticalPos] x[criticalPos+1..m-1]
+    std::size_t period = 1;         // Period of the pattern, or a safe shift when it is not periodic
+    bool periodic = false;          // x[0..criticalPos] occurs again `period` bytes later
+};
+
+/**
+* Computes the maximal suffix of `pattern` for the ordinary (or, with `reversed`, the
+* inverted) alphabet order and the period of that suffix.
+*
+* @return Position just before the maximal suffix, -1 when it is the whole pattern
+*/
+long maximalSuffix(const char* pattern, std::size_t m, std::size_t& period, bool reversed) {
+    long suffix = -1;
+    std::size_t j = 0, k = 1, p = 1;
+    while (j + k < m) {
+        unsigned char a = pattern[j + k];
+        unsigned char b = pattern[suffix + k];
+        if (reversed ? a > b : a < b) {
+            j += k;
+            k = 1;
+            p = j - suffix;
+        } else if (a == b) {
+            if (k != p) {
+                k++;
+            } else {
+                j += p;
+                k = 1;
+            }
+        } else {
+            suffix = j++;
+            k = p = 1;
+        }
+    }
+    period = p;
+    return suffix;
+}
+
+TwoWayPattern compileTwoWay(const char* pattern, std::size_t m) {
+    TwoWayPattern twoWay;
+    twoWay.pattern = pattern;
+    twoWay.length = m;
+    if (m == 0) return twoWay;
+
+    // The later of the two maximal suffixes gives a critical factorization
+    std::size_t period = 1, periodReversed = 1;
+    long suffix = maximalSuffix(pattern, m, period, false);
+    long suffixReversed = maximalSuffix(pattern, m, periodReversed, true);
+    if (suffixReversed > suffix) {
+        suffix = suffixReversed;
+        period = periodReversed;
+    }
+    twoWay.criticalPos = suffix;
+
+    if (std::memcmp(pattern, pattern + period, suffix + 1) == 0) {
+        twoWay.periodic = true;
+        twoWay.period = period;
+    } else {
+        twoWay.periodic = false;
+        twoWay.period = std::max<std::size_t>(suffix + 1, m - suffix - 1) + 1;
+    }
+    return twoWay;
+}
+
+/**
+* Two-Way (Crochemore-Perrin) search. Each alignment first compares the right part of
+* the factorization left to right, and shifts by the length matched there on a mismatch;
+* only then is the left part compared right to left. For periodic patterns the prefix known
+* to match after a shift by the period is remembered and not compared again. Linear time
+* in the worst case (at most 2n comparisons) and no tables at all.
+*
+* @param text Pointer to the text to be searched
+* @param n Length of the text
+* @param twoWay The factorized pattern (must not be empty)
+* @param onMatch Called with the starting offset of each match
+*/
+template <typename OnMatch>
+void scanTwoWay(const char* text, std::size_t n, const TwoWayPattern& twoWay, OnMatch&& onMatch) {
+    const char* pattern = twoWay.pattern;
+    const long m = twoWay.length;
+    const long ell = twoWay.criticalPos;
+    const std::size_t period = twoWay.period;
+    if (m == 0 || n < (std::size_t)m) return;
+
+    std::size_t shift = 0;
+    long memory = -1;  // Prefix x[0..memory] is known to match at this alignment (periodic case)
+    while (shift <= n - m) {
+        long i = std::max(ell, memory) + 1;
+        while (i < m && pattern[i] == text[shift + i]) i++;
+
+        if (i < m) {
+            shift += i - ell;
+            memory = -1;
+            continue;
+        }
+
+        long lower = twoWay.periodic ? memory : -1;
+        i = ell;
+        while (i > lower && pattern[i] == text[shift + i]) i--;
+        if (i <= lower) onMatch(shift);
+
+        shift += period;
+        if (twoWay.periodic) memory = m - period - 1;
+    }
+}
+
+std::vector<std::size_t> findMatchesTwoWay(const char* text, std::size_t n, const TwoWayPattern& twoWay) {
+    std::vector<std::size_t> matches;
+    scanTwoWay(text, n, twoWay, [&](std::size_t offset) { matches.push_back(offset); });
+    return matches;
+}
+
+// =========================
+// Search Planner
+// =========================
+
+enum class SearchEngine { BoyerMoore, TurboBoyerMoore, TwoWay, ApostolicoGiancarlo };
+
+const std::size_t DEFAULT_TABLE_BUDGET = 64 * 1024;  // Bytes the Boyer-Moore tables may use
+const int PERIODIC_RATIO = 4;  // Period at most m / PERIODIC_RATIO counts as highly periodic
+
+const char* engineName(SearchEngine engine) {
+    switch (engine) {
+        case SearchEngine::BoyerMoore: return "Boyer-Moore";
+        case SearchEngine::TurboBoyerMoore: return "Turbo-BM";
+        case SearchEngine::TwoWay: return "Two-Way";
+        case SearchEngine::ApostolicoGiancarlo: return "Apostolico-Giancarlo";
+    }
+    return "";
+}
+
+/**
+* A pattern prepared for the engine the planner chose. `compiled.pattern` always owns
+* the pattern bytes and `twoWay` is always valid; the tables of `compiled` are only
+* filled in for the Boyer-Moore engines. Change the engine by planning again with
+* `planSearch`, not by assigning `engine`.
+*/
+struct SearchPlan {
+    SearchEngine engine = SearchEngine::BoyerMoore;
+    CompiledPattern compiled;
+    TwoWayPattern twoWay;
+
+    SearchPlan() = default;
+    SearchPlan(const SearchPlan&) = delete;  // `twoWay` points into `compiled.pattern`
+    SearchPlan& operator=(const SearchPlan&) = delete;
+};
+
+/**
+* Prepares a pattern for a given engine, building everything that engine reads, and
+* replaces whatever `plan` held before.
+*
+* @param pattern The pattern to be searched for
+* @param engine The engine to search with
+* @param plan Receives the engine and its preprocessed pattern
+*/
+void planSearch(const std::string& pattern, SearchEngine engine, SearchPlan& plan) {
+    plan.engine = engine;
+    plan.compiled = CompiledPattern();
+    plan.compiled.pattern = pattern;
+    plan.twoWay = compileTwoWay(plan.compiled.pattern.data(), pattern.length());
+    if (engine == SearchEngine::TwoWay) return;
+    precomputeBadCharacterTable(pattern, plan.compiled.badCharTable);
+    precomputeGoodSuffixTable(pattern, plan.compiled.goodSuffixShifts);
+}
+
+/**
+* Picks an engine for a pattern. Two-Way is chosen when the Boyer-Moore tables
+* (256 bad-character entries plus m+1 good-suffix entries) would exceed `tableBudget`,
+* or when the pattern has a short period, the structure that drives the plain loop
+* towards its O(nm) worst case.
+*
+* @param pattern The pattern to be searched for
+* @param plan Receives the chosen engine and its preprocessed pattern
+* @param tableBudget Maximum bytes for the Boyer-Moore tables; 0 forces Two-Way
+*/
+void planSearch(const std::string& pattern, SearchPlan& plan, std::size_t tableBudget = DEFAULT_TABLE_BUDGET) {
+    TwoWayPattern factorization = compileTwoWay(pattern.data(), pattern.length());
+    std::size_t tableBytes = (NUM_CHARS + pattern.length() + 1) * sizeof(int);
+    bool highlyPeriodic = factorization.periodic && factorization.period * PERIODIC_RATIO <= pattern.length();
+    bool twoWay = tableBytes > tableBudget || highlyPeriodic;
+    planSearch(pattern, twoWay ? SearchEngine::TwoWay : SearchEngine::BoyerMoore, plan);
+}
+
+// Looks up an engine by its `engineName`. Returns false if the name is unknown.
+bool parseEngineName(const std::string& name, SearchEngine& engine) {
+    for (SearchEngine candidate : {SearchEngine::BoyerMoore, SearchEngine::TurboBoyerMoore, SearchEngine::TwoWay,
+                                   SearchEngine::ApostolicoGiancarlo}) {
+        if (name == engineName(candidate)) {
+            engine = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs the engine chosen by `planSearch` and returns every match offset in increasing order
+std::vector<std::size_t> findMatchesPlanned(const char* text, std::size_t n, const SearchPlan& plan) {
+    switch (plan.engine) {
+        case SearchEngine::TwoWay: return findMatchesTwoWay(text, n, plan.twoWay);
+        case SearchEngine::TurboBoyerMoore: return findMatchesTurbo(text, n, plan.compiled);
+        case SearchEngine::ApostolicoGiancarlo: return findMatchesApostolicoGiancarlo(text, n, plan.compiled);
+        case SearchEngine::BoyerMoore: break;
+    }
+    return findMatches(text, n, plan.compiled);
+}
+
+// =========================
+// Search Control
+// =========================
+//
+// Long scans can be cancelled from another thread, bounded by a deadline and observed
+// through a progress callback, or driven piecewise through a resumable cursor. Scans run
+// in slices of alignments through the same range API as every other caller of
+// `scanBoyerMoore`, and the control block is only consulted between slices, so the
+// inner loop is unchanged.
+
+enum class SearchStatus { Completed, Cancelled, DeadlineExceeded };
+
+const std::size_t CONTROL_SLICE_SIZE = 1024 * 1024;  // Alignments scanned between two checks
+
+const char* searchStatusName(SearchStatus status) {
+    switch (status) {
+        case SearchStatus::Completed: return "completed";
+        case SearchStatus::Cancelled: return "cancelled";
+        case SearchStatus::DeadlineExceeded: return "deadline exceeded";
+    }
+    return "";
+}
+
+/**
+* Shared between a scan and whoever supervises it. `cancelled` may be set from any
+* thread; `deadline` and `onProgress` are read by the scanning thread only.
+*/
+struct SearchControl {
+    std::atomic<bool> cancelled{false};
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    std::function<void(std::size_t bytesScanned, std::size_t matches)> onProgress;  // Optional
+    std::size_t sliceSize = CONTROL_SLICE_SIZE;
+};
+
+/**
+* Scans the alignments `shift` .. `lastShift` in slices of `control.sliceSize`,
+* checking the control block and reporting progress after each slice.
+*
+* @param onMatch Called with the offset of every match, in order
+* @param nextShift Receives the first alignment not yet scanned (past `lastShift` when complete)
+* @return Completed, or why the scan stopped early
+*/
+template <typename OnMatch>
+SearchStatus scanControlled(const char* text, const CompiledPattern& compiled, std::size_t shift,
+                            std::size_t lastShift, SearchControl& control, OnMatch&& onMatch,
+                            std::size_t& nextShift) {
+    const std::size_t firstShift = shift;
+    const std::size_t sliceSize = std::max<std::size_t>(control.sliceSize, 1);
+    std::size_t matches = 0;
+    auto countMatch = [&](std::size_t offset) {
+        matches++;
+        onMatch(offset);
+    };
+
+    SearchStatus status = SearchStatus::Completed;
+    while (shift <= lastShift) {
+        std::size_t sliceEnd = lastShift - shift < sliceSize ? lastShift : shift + sliceSize - 1;
+        shift = scanBoyerMoore(text, compiled, shift, sliceEnd, countMatch);
+
+        if (control.onProgress) control.onProgress(std::min(shift, lastShift + 1) - firstShift, matches);
+        if (shift > lastShift) break;
+        if (control.cancelled.load(std::memory_order_relaxed)) {
+            status = SearchStatus::Cancelled;
+            break;
+        }
+        if (std::chrono::steady_clock::now() >= control.deadline) {
+            status = SearchStatus::DeadlineExceeded;
+            break;
+        }
+    }
+    nextShift = shift;
+    return status;
+}
+
+/**
+* Controlled counterpart of `findMatches`. On early return, `matches` holds every match
+* before the point where the scan stopped.
+*/
+SearchStatus findMatchesControlled(const char* text, std::size_t n, const CompiledPattern& compiled,
+                                   SearchControl& control, std::vector<std::size_t>& matches) {
+    matches.clear();
+    std::size_t m = compiled.pattern.length();
+    if (m == 0 || n < m) return SearchStatus::Completed;
+    std::size_t nextShift;
+    return scanControlled(text, compiled, 0, n - m, control,
+                          [&](std::size_t offset) { matches.push_back(offset); }, nextShift);
+}
+
+const std::size_t CURSOR_TIME_SLICE = 64 * 1024;  // Alignments between clock reads in time-boxed advances
+
+/**
+* Resumable search state: the next alignment to try and the matches reported so far.
+* The text and the compiled pattern are borrowed and must outlive the cursor, which
+* lets a single-threaded event loop interleave a long scan with other work.
+*/
+struct SearchCursor {
+    const char* text = nullptr;
+    std::size_t n = 0;
+    const CompiledPattern* compiled = nullptr;
+    std::size_t shift = 0;       // Next alignment to try
+    std::size_t lastShift = 0;   // Last valid alignment
+    bool done = true;
+    std::size_t matchCount = 0;
+};
+
+SearchCursor openSearchCursor(const char* text, std::size_t n, const CompiledPattern& compiled) {
+    SearchCursor cursor;
+    cursor.text = text;
+    cursor.n = n;
+    cursor.compiled = &compiled;
+    std::size_t m = compiled.pattern.length();
+    cursor.done = m == 0 || n < m;
+    cursor.lastShift = cursor.done ? 0 : n - m;
+    return cursor;
+}
+
+/**
+* Advances the cursor over at most `maxBytes` alignments.
+*
+* @param onMatch Called with the offset of every match found in this advance, in order
+* @return true once the whole text has been scanned
+*/
+template <typename OnMatch>
+bool advanceCursor(SearchCursor& cursor, std::size_t maxBytes, OnMatch&& onMatch) {
+    if (cursor.done || maxBytes == 0) return cursor.done;
+    std::size_t sliceEnd = cursor.lastShift - cursor.shift < maxBytes ? cursor.lastShift : cursor.shift + maxBytes - 1;
+    cursor.shift = scanBoyerMoore(cursor.text, *cursor.compiled, cursor.shift, sliceEnd, [&](std::size_t offset) {
+        cursor.matchCount++;
+        onMatch(offset);
+    });
+    cursor.done = cursor.shift > cursor.lastShift;
+    return cursor.done;
+}
+
+/**
+* Advances the cursor for roughly `budget`, checking the clock every CURSOR_TIME_SLICE
+* alignments. At least one slice is scanned, so every call makes progress.
+*
+* @return true once the whole text has been scanned
+*/
+template <typename OnMatch>
+bool advanceCursorFor(SearchCursor& cursor, std::chrono::microseconds budget, OnMatch&& onMatch) {
+    if (cursor.done) return true;
+    SearchControl control;
+    control.deadline = std::chrono::steady_clock::now() + budget;
+    control.sliceSize = CURSOR_TIME_SLICE;
+    scanControlled(cursor.text, *cursor.compiled, cursor.shift, cursor.lastShift, control, [&](std::size_t offset) {
+        cursor.matchCount++;
+        onMatch(offset);
+    }, cursor.shift);
+    cursor.done = cursor.shift > cursor.lastShift;
+    return cursor.done;
+}
+
+// =========================
+// Generic Sequence Search
+// =========================
+//
+// The Boyer-Moore engine over arrays of any element type: int16 sensor samples, token IDs,
+// fixed-size records. A projection maps each element to the key that identifies it (the
+// element itself by default); the bad character information for keys lives in a hashed
+// table, since the alphabet is usually far too large for a flat one.
+
+struct IdentityProjection {
+    template <typename T>
+    const T& operator()(const T& value) const { return value; }
+};
+
+// True for types whose equality is exactly equality of their bytes
+template <typename T>
+constexpr bool isBytewiseComparable() {
+    return std::is_trivially_copyable<T>::value && std::has_unique_object_representations<T>::value;
+}
+
+// Compares two keys with memcmp when that is exact, so plain structs need no operator==
+template <typename Key>
+bool keysEqual(const Key& a, const Key& b) {
+    if constexpr (isBytewiseComparable<Key>() && !std::is_integral<Key>::value) {
+        return std::memcmp(&a, &b, sizeof(Key)) == 0;
+    } else {
+        return a == b;
+    }
+}
+
+// Default hash: Fibonacci hashing for integers, FNV-1a over the bytes of plain structs
+template <typename Key>
+struct SequenceHash {
+    std::size_t operator()(const Key& key) const {
+        if constexpr (std::is_integral<Key>::value || std::is_enum<Key>::value) {
+            return (std::size_t)(((uint64_t)key * 0x9e3779b97f4a7c15ull) >> 32);
+        } else if constexpr (isBytewiseComparable<Key>()) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (std::size_t i = 0; i < sizeof(Key); i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+            return (std::size_t)(hash ^ (hash >> 32));
+        } else {
+            return std::hash<Key>()(key);
+        }
+    }
+};
+
+/**
+* Bad character information for an alphabet too large for a flat table. An
+* open-addressing hash table with linear probing maps each key of the pattern to its
+* last index; it has at least twice as many slots as the pattern has elements, so a
+* lookup takes only a few probes.
+*/
+template <typename Key, typename Hash = SequenceHash<Key>>
+struct HashedShiftTable {
+    std::vector<Key> keys;
+    std::vector<int> lastIndex;  // -1 marks an empty slot
+    std::size_t mask = 0;
+    Hash hash;
+};
+
+// Slot of `key`, or of the empty slot where it would be inserted
+template <typename Key, typename Hash>
+std::size_t findKeySlot(const HashedShiftTable<Key, Hash>& table, const Key& key) {
+    std::size_t slot = table.hash(key) & table.mask;
+    while (table.lastIndex[slot] >= 0 && !keysEqual(table.keys[slot], key)) slot = (slot + 1) & table.mask;
+    return slot;
+}
+
+// Last index of `key` in the pattern, or -1 if it does not occur
+template <typename Key, typename Hash>
+int lookupKey(const HashedShiftTable<Key, Hash>& table, const Key& key) {
+    return table.lastIndex[findKeySlot(table, key)];
+}
+
+/**
+* Builds the bad character table of a sequence pattern: the last index of every key.
+*
+* @param keys The projected keys of the pattern
+* @param table A reference to the table that will store the last indices
+*/
+template <typename Key, typename Hash>
+void precomputeHashedShiftTable(const std::vector<Key>& keys, HashedShiftTable<Key, Hash>& table) {
+    std::size_t slots = 4;
+    while (slots < 2 * keys.size()) slots <<= 1;
+    table.keys.assign(slots, Key());
+    table.lastIndex.assign(slots, -1);
+    table.mask = slots - 1;
+    for (int i = 0; i < (int)keys.size(); ++i) {
+        std::size_t slot = findKeySlot(table, keys[i]);
+        table.keys[slot] = keys[i];
+        table.lastIndex[slot] = i;
+    }
+}
+
+template <typename T, typename Projection = IdentityProjection>
+using ProjectedKey = typename std::decay<decltype(std::declval<Projection>()(std::declval<const T&>()))>::type;
+
+/**
+* A sequence pattern with its preprocessed tables. Elements are equal when their
+* projected keys are equal.
+*/
+template <typename T, typename Projection = IdentityProjection, typename Hash = SequenceHash<ProjectedKey<T, Projection>>>
+struct CompiledSequence {
+    std::vector<T> pattern;
+    Projection project;
+    HashedShiftTable<ProjectedKey<T, Projection>, Hash> badKeyTable;
+    std::vector<int> goodSuffixShifts;
+};
+
+template <typename T, typename Projection = IdentityProjection, typename Hash = SequenceHash<ProjectedKey<T, Projection>>>
+CompiledSequence<T, Projection, Hash> compileSequence(const std::vector<T>& pattern,
+                                                      Projection project = Projection(), Hash hash = Hash()) {
+    typedef ProjectedKey<T, Projection> Key;
+    CompiledSequence<T, Projection, Hash> compiled;
+    compiled.pattern = pattern;
+    compiled.project = project;
+    compiled.badKeyTable.hash = hash;
+
+    std::vector<Key> keys;
+    keys.reserve(pattern.size());
+    for (const T& element : pattern) keys.push_back(project(element));
+    precomputeHashedShiftTable(keys, compiled.badKeyTable);
+    precomputeGoodSuffixTable(keys, compiled.goodSuffixShifts,
+                              [](const Key& a, const Key& b) { return keysEqual(a, b); });
+    return compiled;
+}
+
+/**
+* Finds a sequence pattern in an array with the Boyer-Moore loop. When elements are
+* compared as a whole and are bytewise comparable, an alignment whose last element
+* matches is verified with a single memcmp, and only a failed memcmp falls back to the
+* element-by-element compare that locates the mismatch for the shift tables.
+*
+* @param text Pointer to the elements to be searched
+* @param n Number of elements
+* @param compiled The compiled pattern
+* @return Element offsets of every match in increasing order
+*/
+template <typename T, typename Projection, typename Hash>
+std::vector<std::size_t> findSequence(const T* text, std::size_t n, const CompiledSequence<T, Projection, Hash>& compiled) {
+    constexpr bool bytewise = std::is_same<Projection, IdentityProjection>::value && isBytewiseComparable<T>();
+    std::vector<std::size_t> matches;
+    const std::vector<T>& pattern = compiled.pattern;
+    const int m = pattern.size();
+    if (m == 0 || n < (std::size_t)m) return matches;
+
+    auto equal = [&](const T& a, const T& b) { return keysEqual(compiled.project(a), compiled.project(b)); };
+    std::size_t shift = 0;
+    while (shift <= n - m) {
+        int j = m - 1;
+        if (bytewise && equal(pattern[j], text[shift + j]) &&
+            std::memcmp(pattern.data(), text + shift, m * sizeof(T)) == 0) {
+            j = -1;
+        } else {
+            while (j >= 0 && equal(pattern[j], text[shift + j])) j--;
+        }
+
+        if (j < 0) {
+            matches.push_back(shift);
+            shift += compiled.goodSuffixShifts[0];
+        } else {
+            int badKeyShift = j - lookupKey(compiled.badKeyTable, compiled.project(text[shift + j]));
+            shift += std::max(badKeyShift, compiled.goodSuffixShifts[j + 1]);
+        }
+    }
+    return matches;
+}
+
+// Token phrases over 32-bit token IDs are the plain instantiation of the generic engine
+typedef CompiledSequence<uint32_t> CompiledTokenPattern;
+
+CompiledTokenPattern compileTokenPattern(const std::vector<uint32_t>& pattern) {
+    return compileSequence(pattern);
+}
+
+std::vector<std::size_t> findTokenSequence(const std::vector<uint32_t>& tokens, const CompiledTokenPattern& compiled) {
+    return findSequence(tokens.data(), tokens.size(), compiled);
+}
+
+// =========================
+// Coroutine Match Generator
+// =========================
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+const std::size_t COROUTINE_FRAME_BLOCK = 512;  // Frames up to this size are recycled
+const std::size_t COROUTINE_FRAME_CACHE = 16;   // Free frames kept per thread
+
+/**
+* Per-thread cache of coroutine frames. A consumer that creates generator after generator
+* reuses the same few blocks instead of going to the global allocator each time, and when
+* the compiler elides the frame allocation (HALO) these functions are never called at all.
+*/
+struct CoroutineFramePool {
+    std::vector<void*> freeFrames;
+
+    ~CoroutineFramePool() {
+        for (void* frame : freeFrames) ::operator delete(frame);
+    }
+};
+
+thread_local CoroutineFramePool coroutineFramePool;
+
+void* allocateCoroutineFrame(std::size_t size) {
+    if (size > COROUTINE_FRAME_BLOCK) return ::operator new(size);
+    std::vector<void*>& freeFrames = coroutineFramePool.freeFrames;
+    if (freeFrames.empty()) return ::operator new(COROUTINE_FRAME_BLOCK);
+    void* frame = freeFrames.back();
+    freeFrames.pop_back();
+    return frame;
+}
+
+void releaseCoroutineFrame(void* frame, std::size_t size) {
+    std::vector<void*>& freeFrames = coroutineFramePool.freeFrames;
+    if (size <= COROUTINE_FRAME_BLOCK && freeFrames.size() < COROUTINE_FRAME_CACHE) {
+        freeFrames.push_back(frame);
+    } else {
+        ::operator delete(frame);
+    }
+}
+
+/**
+* A lazily evaluated sequence of match offsets produced by a coroutine. Each call to
+* `next()` resumes the search until the following match (or the end of the text), so
+* the consumer decides when to continue and can simply drop the generator to stop early.
+* Also usable in a range-based for loop.
+*/
+class MatchGenerator {
+public:
+    struct promise_type {
+        std::size_t current = 0;
+
+        MatchGenerator get_return_object() {
+            return MatchGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(std::size_t offset) noexcept {
+            current = offset;
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(std::size_t size) { return allocateCoroutineFrame(size); }
+        static void operator delete(void* frame, std::size_t size) { releaseCoroutineFrame(frame, size); }
+    };
+
+    struct iterator {
+        MatchGenerator* generator;
+        std::size_t operator*() const { return generator->value(); }
+        iterator& operator++() {
+            if (!generator->next()) generator = nullptr;
+            return *this;
+        }
+        bool operator!=(const iterator& other) const { return generator != other.generator; }
+    };
+
+    explicit MatchGenerator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    MatchGenerator(MatchGenerator&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    MatchGenerator(const MatchGenerator&) = delete;
+    MatchGenerator& operator=(const MatchGenerator&) = delete;
+    ~MatchGenerator() {
+        if (handle) handle.destroy();
+    }
+
+    // Runs the search up to the next match. Returns false once the text is exhausted.
+    bool next() {
+        if (!handle || handle.done()) return false;
+        handle.resume();
+        return !handle.done();
+    }
+
+    // Offset of the match found by the last successful `next()`
+    std::size_t value() const { return handle.promise().current; }
+
+    iterator begin() { return iterator{next() ? this : nullptr}; }
+    iterator end() { return iterator{nullptr}; }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+* The Boyer-Moore loop of `scanBoyerMoore` as a coroutine: `shift` and `j` live in the
+* coroutine frame and the search suspends at every match. The text and the compiled
+* pattern are referenced, not copied, and must outlive the generator.
+*
+* @param text Pointer to the text to be searched
+* @param n Length of the text
+* @param compiled The compiled pattern
+*/
+MatchGenerator generateMatches(const char* text, std::size_t n, const CompiledPattern& compiled) {
+    const int m = compiled.pattern.length();
+    if (m == 0 || n < (std::size_t)m) co_return;
+
+    std::size_t shift = 0;
+    while (shift <= n - m) {
+        int j = m - 1;
+        while (j >= 0 && compiled.pattern[j] == text[shift + j]) j--;
+
+        if (j < 0) {
+            co_yield shift;
+            shift += compiled.goodSuffixShifts[0];
+        } else {
+            int badCharShift = j - compiled.badCharTable[(unsigned char)text[shift + j]];
+            shift += std::max(badCharShift, compiled.goodSuffixShifts[j + 1]);
+        }
+    }
+}
+
+#endif // __cpp_impl_coroutine
+
+// =========================
+// Parallel Search
+// =========================
+
+const std::size_t MATCH_CHUNK_SIZE = 4096;  // Offsets per chunk of a thread's match buffer
+
+/**
+* Matches found by one thread. Offsets are appended to fixed-size chunks, so a growing
+* buffer never reallocates and copies what it already holds. Each thread fills a buffer
+* on its own stack and only moves it into the shared array after its scan, which keeps
+* the hot path free of locks and of writes to shared cache lines.
+*/
+struct MatchBuffer {
+    std::vector<std::unique_ptr<std::size_t[]>> chunks;
+    std::size_t count = 0;  // Total offsets stored over all chunks
+};
+
+void appendMatch(MatchBuffer& buffer, std::size_t offset) {
+    std::size_t slot = buffer.count % MATCH_CHUNK_SIZE;
+    if (slot == 0) buffer.chunks.emplace_back(new std::size_t[MATCH_CHUNK_SIZE]);
+    buffer.chunks.back()[slot] = offset;
+    buffer.count++;
+}
+
+// Copies every offset of `buffer` in order to `out`
+void copyMatches(const MatchBuffer& buffer, std::size_t* out) {
+    std::size_t remaining = buffer.count;
+    for (const std::unique_ptr<std::size_t[]>& chunk : buffer.chunks) {
+        std::size_t length = std::min(remaining, MATCH_CHUNK_SIZE);
+        std::copy(chunk.get(), chunk.get() + length, out);
+        out += length;
+        remaining -= length;
+    }
+}
+
+/**
+* Searches a text with several threads. The alignments 0..n-m are split into one
+* contiguous range per thread; since a thread reads up to m-1 bytes past its last
+* alignment, matches straddling a range boundary are found exactly once. Because
+* the ranges are ordered, concatenating the per-thread buffers in range order gives
+* a globally ordered result: each thread copies its own buffer to an offset computed
+* from the prefix sum of the counts, again without locks.
+*
+* @param text Pointer to the text to be searched
+* @param n Length of the text
+* @param compiled The compiled pattern
+* @param threadCount Number of threads; 0 uses the hardware concurrency
+* @return The starting offsets of every match in increasing order
+*/
+std::vector<std::size_t> findMatchesParallel(const char* text, std::size_t n, const CompiledPattern& compiled,
+                                             unsigned threadCount = 0) {
+    std::size_t m = compiled.pattern.length();
+    if (m == 0 || n < m) return std::vector<std::size_t>();
+
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t alignments = n - m + 1;
+    if (threadCount > alignments) threadCount = alignments;
+    if (threadCount == 1) return findMatches(text, n, compiled);
+
+    std::vector<MatchBuffer> buffers(threadCount);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threadCount; t++) {
+        std::size_t begin = alignments * t / threadCount;
+        std::size_t end = alignments * (t + 1) / threadCount;
+        workers.emplace_back([&, t, begin, end]() {
+            MatchBuffer buffer;
+            scanBoyerMoore(text, compiled, begin, end - 1, [&](std::size_t offset) { appendMatch(buffer, offset); });
+            buffers[t] = std::move(buffer);
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    // Merge by concatenation in range order
+    std::vector<std::size_t> outputPos(threadCount + 1, 0);
+    for (unsigned t = 0; t < threadCount; t++) outputPos[t + 1] = outputPos[t] + buffers[t].count;
+    std::vector<std::size_t> matches(outputPos[threadCount]);
+
+    workers.clear();
+    for (unsigned t = 0; t < threadCount; t++) {
+        workers.emplace_back([&, t]() { copyMatches(buffers[t], matches.data() + outputPos[t]); });
+    }
+    for (std::thread& worker : workers) worker.join();
+    return matches;
+}
+
+/**
+* Benchmarks `findMatchesParallel` at a high match density ("ab" in "abab...", a match
+* every second byte) for 1, 2, 4, ... threads, next to a baseline where all threads
+* push into one mutex-protected vector. Prints time and throughput per thread count.
+*/
+int benchmarkParallelSearch() {
+    const std::size_t textLength = 64u << 20;
+    std::string text(textLength, 'a');
+    for (std::size_t i = 1; i < textLength; i += 2) text[i] = 'b';
+    CompiledPattern compiled = compilePattern("ab");
+
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Parallel search over " << (textLength >> 20) << " MiB, pattern \"ab\"" << std::endl;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::size_t> matches = findMatchesParallel(text.data(), text.size(), compiled, threads);
+        double perThreadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Baseline: every thread pushes into one shared vector under a lock
+        std::vector<std::size_t> shared;
+        std::mutex sharedLock;
+        start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        std::size_t alignments = textLength - 1;
+        for (unsigned t = 0; t < threads; t++) {
+            std::size_t begin = alignments * t / threads;
+            std::size_t end = alignments * (t + 1) / threads;
+            workers.emplace_back([&, begin, end]() {
+                scanBoyerMoore(text.data(), compiled, begin, end - 1, [&](std::size_t offset) {
+                    std::lock_guard<std::mutex> guard(sharedLock);
+                    shared.push_back(offset);
+                });
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+        std::sort(shared.begin(), shared.end());
+        double sharedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Threads: " << threads << "      - Matches: " << matches.size()
+                  << "      - Per-thread buffers: " << perThreadMs << " ms ("
+                  << matches.size() / perThreadMs / 1000.0 << " M matches/s)"
+                  << "      - Shared locked vector: " << sharedMs << " ms" << std::endl;
+        if (shared != matches) {
+            std::cerr << "Result mismatch between per-thread and shared search" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// =========================
+// Local Search Daemon
+// =========================
+//
+// Binary protocol over a Unix domain socket (host byte order, both ends on the same machine):
+//   Request:  uint8 opcode | uint32 payload length | payload  (at most MAX_REQUEST_PAYLOAD)
+//   Response: uint8 status | uint64 payload length | payload
+//
+//   OP_COMPILE        payload = pattern bytes                   -> uint32 pattern id
+//   OP_LOAD_CORPUS    payload = file path                       -> uint32 corpus id
+//   OP_SEARCH_CORPUS  payload = uint32 pattern id, uint32 corpus id -> uint64 offsets
+//   OP_SEARCH_TEXT    payload = uint32 pattern id, text bytes    -> uint64 offsets
+//
+// Compiled patterns and loaded corpora stay resident for the lifetime of the daemon, and
+// compiling the same pattern (or loading the same file) again returns the existing id.
+// Corpora are identified by device and inode, not by path, and each search first checks
+// that the file has not changed since it was loaded, reloading it if it has. Patterns are
+// compiled through the search planner, so each gets the engine it suits.
+
+const uint8_t OP_COMPILE = 1;
+const uint8_t OP_LOAD_CORPUS = 2;
+const uint8_t OP_SEARCH_CORPUS = 3;
+const uint8_t OP_SEARCH_TEXT = 4;
+
+const uint8_t STATUS_OK = 0;
+const uint8_t STATUS_BAD_REQUEST = 1;
+const uint8_t STATUS_UNKNOWN_ID = 2;
+const uint8_t STATUS_IO_ERROR = 3;
+
+const uint32_t MAX_REQUEST_PAYLOAD = 1u << 30;
+
+// A read-only memory mapping of a whole file
+struct MappedFile {
+    const char* data = nullptr;
+    std::size_t size = 0;
+};
+
+// Maps the first `size` bytes of an open file; the descriptor may be closed afterwards
+bool mapDescriptor(int fd, std::size_t size, MappedFile& mapped) {
+    mapped.size = size;
+    mapped.data = nullptr;
+    if (size == 0) return true;
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) return false;
+    mapped.data = static_cast<const char*>(address);
+    return true;
+}
+
+bool mapFile(const std::string& path, MappedFile& mapped) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0 && mapDescriptor(fd, info.st_size, mapped);
+    close(fd);
+    return ok;
+}
+
+void unmapFile(MappedFile& mapped) {
+    if (mapped.data != nullptr) munmap(const_cast<char*>(mapped.data), mapped.size);
+    mapped.data = nullptr;
+    mapped.size = 0;
+}
+
+// Reads or writes exactly `length` bytes, retrying on short transfers. Returns false on EOF or error.
+bool readFully(int fd, void* buffer, std::size_t length) {
+    char* out = static_cast<char*>(buffer);
+    while (length > 0) {
+        ssize_t got = read(fd, out, length);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        out += got;
+        length -= got;
+    }
+    return true;
+}
+
+bool writeFully(int fd, const void* buffer, std::size_t length) {
+    const char* in = static_cast<const char*>(buffer);
+    while (length > 0) {
+        ssize_t put = write(fd, in, length);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        in += put;
+        length -= put;
+    }
+    return true;
+}
+
+// Sends a request; payloads over MAX_REQUEST_PAYLOAD are refused rather than truncated
+bool sendRequest(int fd, uint8_t opcode, const std::string& payload) {
+    if (payload.size() > MAX_REQUEST_PAYLOAD) return false;
+    uint32_t length = payload.size();
+    return writeFully(fd, &opcode, sizeof(opcode)) && writeFully(fd, &length, sizeof(length)) &&
+           writeFully(fd, payload.data(), length);
+}
+
+bool receiveRequest(int fd, uint8_t& opcode, std::string& payload) {
+    uint32_t length = 0;
+    if (!readFully(fd, &opcode, sizeof(opcode)) || !readFully(fd, &length, sizeof(length))) return false;
+    if (length > MAX_REQUEST_PAYLOAD) return false;
+    payload.resize(length);
+    return readFully(fd, &payload[0], length);
+}
+
+// Writes a response header; the caller then writes exactly `length` payload bytes
+bool sendResponseHeader(int fd, uint8_t status, uint64_t length) {
+    return writeFully(fd, &status, sizeof(status)) && writeFully(fd, &length, sizeof(length));
+}
+
+bool sendResponse(int fd, uint8_t status, const void* payload, uint64_t length) {
+    return sendResponseHeader(fd, status, length) && writeFully(fd, payload, length);
+}
+
+// Returns false if the connection failed or the payload does not fit in memory
+bool receiveResponse(int fd, uint8_t& status, std::string& payload) {
+    uint64_t length = 0;
+    if (!readFully(fd, &status, sizeof(status)) || !readFully(fd, &length, sizeof(length))) return false;
+    if (length > payload.max_size()) return false;
+    try {
+        payload.resize(length);
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    return readFully(fd, &payload[0], length);
+}
+
+// Files up to this size are copied into the daemon rather than mapped, so that a
+// truncation racing a search cannot fault the daemon with SIGBUS
+const std::size_t DAEMON_COPY_LIMIT = 64 * 1024 * 1024;
+
+/**
+* One version of a loaded corpus: its bytes, and the file status they were read at.
+* Files up to DAEMON_COPY_LIMIT are copied in; larger ones are mapped.
+*/
+struct CorpusSnapshot {
+    struct stat info;
+    std::string contents;
+    MappedFile mapped;
+
+    CorpusSnapshot() = default;
+    CorpusSnapshot(const CorpusSnapshot&) = delete;
+    CorpusSnapshot& operator=(const CorpusSnapshot&) = delete;
+    ~CorpusSnapshot() { unmapFile(mapped); }
+
+    const char* data() const { return mapped.data != nullptr ? mapped.data : contents.data(); }
+    std::size_t size() const { return mapped.data != nullptr ? mapped.size : contents.size(); }
+};
+
+/**
+* A resident corpus keeps its file open, so a rewrite in place is seen by `fstat`.
+* `reload` guards `snapshot`; a search of this corpus holds it only while checking the
+* file and, if it changed, reading it again.
+*/
+struct DaemonCorpus {
+    int fd = -1;
+    std::mutex reload;
+    std::shared_ptr<const CorpusSnapshot> snapshot;
+};
+
+/**
+* State kept resident by the search daemon: every compiled pattern and loaded corpus,
+* plus lookup maps so that repeated requests reuse them instead of preprocessing again.
+* Corpora are keyed by (st_dev, st_ino). Connections are served by their own threads;
+* `lock` guards the tables and is only held to look entries up or add them. Planning a
+* pattern, loading or reloading a corpus and searching all run on shared pointers taken
+* out of the tables, with `lock` released.
+*/
+struct SearchDaemon {
+    std::mutex lock;
+    std::vector<std::shared_ptr<const SearchPlan>> patterns;
+    std::vector<std::shared_ptr<DaemonCorpus>> corpora;
+    std::map<std::string, uint32_t> patternIds;
+    std::map<std::pair<uint64_t, uint64_t>, uint32_t> corpusIds;
+};
+
+// True when both describe the same contents of the same file, as far as stat can tell
+bool sameFileVersion(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+           a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec &&
+           a.st_ctim.tv_sec == b.st_ctim.tv_sec && a.st_ctim.tv_nsec == b.st_ctim.tv_nsec;
+}
+
+// Reads or maps the current contents of an open regular file; null on failure
+std::shared_ptr<const CorpusSnapshot> loadCorpusSnapshot(int fd, const struct stat& info) {
+    if (!S_ISREG(info.st_mode)) return nullptr;
+    auto snapshot = std::make_shared<CorpusSnapshot>();
+    snapshot->info = info;
+    std::size_t size = info.st_size;
+    if (size <= DAEMON_COPY_LIMIT) {
+        snapshot->contents.resize(size);
+        if (size > 0 && (lseek(fd, 0, SEEK_SET) != 0 || !readFully(fd, &snapshot->contents[0], size))) return nullptr;
+    } else if (!mapDescriptor(fd, size, snapshot->mapped)) {
+        return nullptr;
+    }
+    return snapshot;
+}
+
+/**
+* Returns the current contents of a corpus, reloading them first if its file changed
+* since the last load. Returns null if the file cannot be read.
+*/
+std::shared_ptr<const CorpusSnapshot> refreshCorpus(DaemonCorpus& corpus) {
+    std::lock_guard<std::mutex> guard(corpus.reload);
+    struct stat info;
+    if (fstat(corpus.fd, &info) != 0) return nullptr;
+    if (corpus.snapshot != nullptr && sameFileVersion(corpus.snapshot->info, info)) return corpus.snapshot;
+    std::shared_ptr<const CorpusSnapshot> snapshot = loadCorpusSnapshot(corpus.fd, info);
+    if (snapshot != nullptr) corpus.snapshot = snapshot;
+    return snapshot;
+}
+
+bool sendId(int fd, uint32_t id) {
+    return sendResponse(fd, STATUS_OK, &id, sizeof(id));
+}
+
+const std::size_t MATCH_SEND_BATCH = 64 * 1024;  // Offsets converted and written per write call
+
+// Sends the match offsets as uint64 values, converting them a batch at a time
+bool sendMatches(int fd, const std::vector<std::size_t>& matches) {
+    if (!sendResponseHeader(fd, STATUS_OK, (uint64_t)matches.size() * sizeof(uint64_t))) return false;
+    std::vector<uint64_t> batch;
+    for (std::size_t i = 0; i < matches.size(); i += MATCH_SEND_BATCH) {
+        std::size_t end = std::min(matches.size(), i + MATCH_SEND_BATCH);
+        batch.assign(matches.begin() + i, matches.begin() + end);
+        if (!writeFully(fd, batch.data(), batch.size() * sizeof(uint64_t))) return false;
+    }
+    return true;
+}
+
+/**
+* Handles one request from a client and writes its response.
+*
+* @return false when the response could not be written and the connection should be dropped
+*/
+bool handleDaemonRequest(SearchDaemon& daemon, int fd, uint8_t opcode, const std::string& payload) {
+    if (opcode == OP_COMPILE) {
+        if (payload.empty()) return sendResponse(fd, STATUS_BAD_REQUEST, nullptr, 0);
+        {
+            std::lock_guard<std::mutex> guard(daemon.lock);
+            auto known = daemon.patternIds.find(payload);
+            if (known != daemon.patternIds.end()) return sendId(fd, known->second);
+        }
+
+        auto plan = std::make_shared<SearchPlan>();
+        planSearch(payload, *plan);
+        std::lock_guard<std::mutex> guard(daemon.lock);
+        auto known = daemon.patternIds.find(payload);  // Another client may have compiled it meanwhile
+        if (known != daemon.patternIds.end()) return sendId(fd, known->second);
+        uint32_t id = daemon.patterns.size();
+        daemon.patterns.push_back(plan);
+        daemon.patternIds[payload] = id;
+        return sendId(fd, id);
+    }
+
+    if (opcode == OP_LOAD_CORPUS) {
+        int corpusFd = open(payload.c_str(), O_RDONLY);
+        struct stat info;
+        if (corpusFd < 0) return sendResponse(fd, STATUS_IO_ERROR, nullptr, 0);
+        if (fstat(corpusFd, &info) != 0) {
+            close(corpusFd);
+            return sendResponse(fd, STATUS_IO_ERROR, nullptr, 0);
+        }
+
+        std::pair<uint64_t, uint64_t> key(info.st_dev, info.st_ino);
+        uint32_t id = 0;
+        std::shared_ptr<DaemonCorpus> known;
+        {
+            std::lock_guard<std::mutex> guard(daemon.lock);
+            auto found = daemon.corpusIds.find(key);
+            if (found != daemon.corpusIds.end()) {
+                id = found->second;
+                known = daemon.corpora[id];
+            }
+        }
+        if (known != nullptr) {
+            close(corpusFd);
+            if (refreshCorpus(*known) == nullptr) return sendResponse(fd, STATUS_IO_ERROR, nullptr, 0);
+            return sendId(fd, id);
+        }
+
+        auto corpus = std::make_shared<DaemonCorpus>();
+        corpus->fd = corpusFd;
+        corpus->snapshot = loadCorpusSnapshot(corpusFd, info);
+        if (corpus->snapshot == nullptr) {
+            close(corpusFd);
+            return sendResponse(fd, STATUS_IO_ERROR, nullptr, 0);
+        }
+        std::lock_guard<std::mutex> guard(daemon.lock);
+        auto found = daemon.corpusIds.find(key);  // Another client may have loaded it meanwhile
+        if (found != daemon.corpusIds.end()) {
+            close(corpusFd);
+            return sendId(fd, found->second);
+        }
+        id = daemon.corpora.size();
+        daemon.corpora.push_back(corpus);
+        daemon.corpusIds[key] = id;
+        return sendId(fd, id);
+    }
+
+    if (opcode == OP_SEARCH_CORPUS || opcode == OP_SEARCH_TEXT) {
+        uint32_t patternId = 0;
+        uint32_t corpusId = 0;
+        if (payload.size() < sizeof(patternId)) return sendResponse(fd, STATUS_BAD_REQUEST, nullptr, 0);
+        std::memcpy(&patternId, payload.data(), sizeof(patternId));
+        if (opcode == OP_SEARCH_CORPUS) {
+            if (payload.size() != sizeof(patternId) + sizeof(corpusId))
+                return sendResponse(fd, STATUS_BAD_REQUEST, nullptr, 0);
+            std::memcpy(&corpusId, payload.data() + sizeof(patternId), sizeof(corpusId));
+        }
+
+        std::shared_ptr<const SearchPlan> plan;
+        std::shared_ptr<DaemonCorpus> corpus;
+        {
+            std::lock_guard<std::mutex> guard(daemon.lock);
+            if (patternId >= daemon.patterns.size()) return sendResponse(fd, STATUS_UNKNOWN_ID, nullptr, 0);
+            plan = daemon.patterns[patternId];
+            if (opcode == OP_SEARCH_CORPUS) {
+                if (corpusId >= daemon.corpora.size()) return sendResponse(fd, STATUS_UNKNOWN_ID, nullptr, 0);
+                corpus = daemon.corpora[corpusId];
+            }
+        }
+
+        if (opcode == OP_SEARCH_TEXT) {
+            const char* text = payload.data() + sizeof(patternId);
+            return sendMatches(fd, findMatchesPlanned(text, payload.size() - sizeof(patternId), *plan));
+        }
+        std::shared_ptr<const CorpusSnapshot> snapshot = refreshCorpus(*corpus);
+        if (snapshot == nullptr) return sendResponse(fd, STATUS_IO_ERROR, nullptr, 0);
+        return sendMatches(fd, findMatchesPlanned(snapshot->data(), snapshot->size(), *plan));
+    }
+
+    return sendResponse(fd, STATUS_BAD_REQUEST, nullptr, 0);
+}
+
+int openUnixSocket(const std::string& socketPath, sockaddr_un& address) {
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << socketPath << std::endl;
+        return -1;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) std::cerr << "socket: " << std::strerror(errno) << std::endl;
+    return fd;
+}
+
+// Serves one client until it disconnects
+void serveDaemonConnection(std::shared_ptr<SearchDaemon> daemon, int clientFd) {
+    uint8_t opcode = 0;
+    std::string payload;
+    while (receiveRequest(clientFd, opcode, payload)) {
+        if (!handleDaemonRequest(*daemon, clientFd, opcode, payload)) break;
+    }
+    close(clientFd);
+}
+
+// Removes a stale socket left at `socketPath`, refusing to touch anything that is not a socket
+bool removeStaleSocket(const std::string& socketPath) {
+    struct stat info;
+    if (lstat(socketPath.c_str(), &info) != 0) return errno == ENOENT;
+    if (!S_ISSOCK(info.st_mode)) {
+        std::cerr << socketPath << " exists and is not a socket" << std::endl;
+        return false;
+    }
+    return unlink(socketPath.c_str()) == 0;
+}
+
+/**
+* Runs the search daemon on a Unix domain socket. Each connection is served by its own
+* thread, so clients are served concurrently and may send any number of requests per
+* connection. Only returns on a setup or accept error.
+*
+* @param socketPath Filesystem path of the socket; a stale socket left there is replaced,
+*        but any other kind of file makes the daemon refuse to start
+* @return Non-zero exit code on failure
+*/
+int runSearchDaemon(const std::string& socketPath) {
+    sockaddr_un address;
+    int listenFd = openUnixSocket(socketPath, address);
+    if (listenFd < 0) return 1;
+
+    if (!removeStaleSocket(socketPath)) {
+        close(listenFd);
+        return 1;
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 16) != 0) {
+        std::cerr << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(listenFd);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);  // A client hanging up must not kill the daemon
+    std::cout << "Search daemon listening on " << socketPath << std::endl;
+
+    // Connection threads are detached and share ownership of the daemon state, so an idle
+    // client never holds up the others
+    auto daemon = std::make_shared<SearchDaemon>();
+    while (true) {
+        int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "accept: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        try {
+            std::thread(serveDaemonConnection, daemon, clientFd).detach();
+        } catch (const std::system_error&) {
+            close(clientFd);  // Out of threads: drop this client, keep serving the others
+        }
+    }
+
+    close(listenFd);
+    removeStaleSocket(socketPath);
+    return 1;
+}
+
+// Sends one request and waits for its response. Returns false if the connection failed.
+bool daemonRequest(int fd, uint8_t opcode, const std::string& payload, uint8_t& status, std::string& response) {
+    return sendRequest(fd, opcode, payload) && receiveResponse(fd, status, response);
+}
+
+/**
+* Client side of the daemon: asks it to compile `pattern` and search the file at `path`,
+* then prints the matching offsets. Both stay resident in the daemon for later queries.
+*
+* @return Non-zero exit code on failure
+*/
+int querySearchDaemon(const std::string& socketPath, const std::string& pattern, const std::string& path) {
+    // The daemon has its own working directory, so relative paths are resolved here
+    char* resolved = realpath(path.c_str(), nullptr);
+    if (resolved == nullptr) {
+        std::cerr << "Cannot resolve " << path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::string absolutePath(resolved);
+    free(resolved);
+
+    sockaddr_un address;
+    int fd = openUnixSocket(socketPath, address);
+    if (fd < 0) return 1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Cannot connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    uint8_t status = STATUS_OK;
+    std::string patternReply, corpusReply, searchReply;
+    bool sent = daemonRequest(fd, OP_COMPILE, pattern, status, patternReply) && status == STATUS_OK &&
+                daemonRequest(fd, OP_LOAD_CORPUS, absolutePath, status, corpusReply) && status == STATUS_OK &&
+                daemonRequest(fd, OP_SEARCH_CORPUS, patternReply + corpusReply, status, searchReply) &&
+                status == STATUS_OK;
+    close(fd);
+    if (!sent) {
+        std::cerr << "Search request failed (status " << (int)status << ")" << std::endl;
+        return 1;
+    }
+
+    std::size_t count = searchReply.size() / sizeof(uint64_t);
+    std::cout << "The pattern matched the text at index: ";
+    for (std::size_t i = 0; i < count; i++) {
+        uint64_t offset = 0;
+        std::memcpy(&offset, searchReply.data() + i * sizeof(uint64_t), sizeof(offset));
+        std::cout << offset << " ";
+    }
+    std::cout << "\nTotal Matches: " << count << std::endl;
+    return 0;
+}
+
+// =========================
+// Shared-Memory Match Ring
+// =========================
+//
+// A single-producer/single-consumer ring of fixed-size match records in POSIX shared
+// memory. The search process writes records straight into the mapping and a downstream
+// process reads them from its own mapping of the same object, so matches are delivered
+// without copies into intermediate containers or any serialization.
+
+const uint32_t MATCH_RING_MAGIC = 0x424d5247;  // "BMRG"
+const uint32_t MAX_MATCH_RING_CAPACITY = 1u << 31;  // Largest power of two in a uint32_t
+
+// One match as seen by a consumer; 16 bytes so records never straddle a cache line
+struct MatchRecord {
+    uint64_t offset;     // Starting offset of the match in the text
+    uint32_t patternId;  // Identifies the pattern for consumers fed by several searches
+    uint32_t reserved;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters must be address-free");
+
+/**
+* Header at the start of the shared mapping. `head` is only written by the producer and
+* `tail` only by the consumer; they live on separate cache lines to avoid false sharing.
+* Both count records ever written/read, and the slot is the count modulo `capacity`.
+*/
+struct MatchRingHeader {
+    uint32_t magic;
+    uint32_t capacity;                       // Number of record slots, a power of two
+    alignas(64) std::atomic<uint64_t> head;  // Records published by the producer
+    alignas(64) std::atomic<uint64_t> tail;  // Records consumed by the consumer
+    alignas(64) std::atomic<uint32_t> finished;  // Set once the producer has written its last record
+};
+
+// A process-local view of a shared ring. `capacity` is copied out of the header once it
+// has been validated, so a peer rewriting the header cannot steer accesses out of bounds.
+struct SharedMatchRing {
+    MatchRingHeader* header = nullptr;
+    MatchRecord* records = nullptr;
+    std::size_t mappedSize = 0;
+    uint32_t capacity = 0;
+    uint64_t cachedPeer = 0;  // Last seen `tail` (producer) or `head` (consumer)
+};
+
+bool mapMatchRing(int fd, std::size_t size, SharedMatchRing& ring) {
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) return false;
+    ring.header = static_cast<MatchRingHeader*>(address);
+    ring.records = reinterpret_cast<MatchRecord*>(static_cast<char*>(address) + sizeof(MatchRingHeader));
+    ring.mappedSize = size;
+    ring.cachedPeer = 0;
+    return true;
+}
+
+/**
+* Creates (or replaces) the shared-memory object `name` and initializes an empty ring in it.
+*
+* @param name POSIX shared memory name, e.g. "/bm-matches"
+* @param capacity Number of record slots; rounded up to a power of two, at most MAX_MATCH_RING_CAPACITY
+* @param ring Receives the producer's view of the ring
+*/
+bool createMatchRing(const std::string& name, uint32_t capacity, SharedMatchRing& ring) {
+    if (capacity > MAX_MATCH_RING_CAPACITY) return false;
+    uint32_t slots = 1;
+    while (slots < capacity) slots <<= 1;
+    std::size_t size = sizeof(MatchRingHeader) + (std::size_t)slots * sizeof(MatchRecord);
+
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return false;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    if (!mapMatchRing(fd, size, ring)) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    MatchRingHeader* header = new (ring.header) MatchRingHeader;
+    header->capacity = slots;
+    ring.capacity = slots;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->finished.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MATCH_RING_MAGIC;
+    return true;
+}
+
+// Attaches to a ring created by `createMatchRing`, typically from the consumer process
+bool openMatchRing(const std::string& name, SharedMatchRing& ring) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (std::size_t)info.st_size < sizeof(MatchRingHeader)) {
+        close(fd);
+        return false;
+    }
+    if (!mapMatchRing(fd, info.st_size, ring)) return false;
+
+    // The object may be foreign or corrupt: the records must fit in what was mapped
+    uint32_t capacity = ring.header->capacity;
+    bool powerOfTwo = capacity != 0 && (capacity & (capacity - 1)) == 0;
+    if (ring.header->magic != MATCH_RING_MAGIC || !powerOfTwo ||
+        (ring.mappedSize - sizeof(MatchRingHeader)) / sizeof(MatchRecord) < capacity) {
+        munmap(ring.header, ring.mappedSize);
+        ring.header = nullptr;
+        return false;
+    }
+    ring.capacity = capacity;
+    return true;
+}
+
+void closeMatchRing(SharedMatchRing& ring) {
+    if (ring.header != nullptr) munmap(ring.header, ring.mappedSize);
+    ring.header = nullptr;
+    ring.records = nullptr;
+    ring.capacity = 0;
+}
+
+/**
+* Writes one record into the ring. While the ring is full the producer waits for the
+* consumer to make room, so a slow consumer throttles the search instead of losing matches.
+*/
+void pushMatch(SharedMatchRing& ring, const MatchRecord& record) {
+    MatchRingHeader* header = ring.header;
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (head - ring.cachedPeer >= ring.capacity) {
+        ring.cachedPeer = header->tail.load(std::memory_order_acquire);
+        if (head - ring.cachedPeer < ring.capacity) break;
+        if (++spins > 64) std::this_thread::yield();
+    }
+    ring.records[head & (ring.capacity - 1)] = record;
+    header->head.store(head + 1, std::memory_order_release);
+}
+
+// Marks the end of the stream; the consumer drains what is left and then stops
+void finishMatchRing(SharedMatchRing& ring) {
+    ring.header->finished.store(1, std::memory_order_release);
+}
+
+/**
+* Reads the next record if one is available.
+*
+* @return false when the ring is currently empty
+*/
+bool popMatch(SharedMatchRing& ring, MatchRecord& record) {
+    MatchRingHeader* header = ring.header;
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    if (tail == ring.cachedPeer) {
+        ring.cachedPeer = header->head.load(std::memory_order_acquire);
+        if (tail == ring.cachedPeer) return false;
+    }
+    record = ring.records[tail & (ring.capacity - 1)];
+    header->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// True once the producer has finished and every record has been consumed
+bool matchRingDrained(SharedMatchRing& ring) {
+    if (!ring.header->finished.load(std::memory_order_acquire)) return false;
+    return ring.header->tail.load(std::memory_order_relaxed) == ring.header->head.load(std::memory_order_acquire);
+}
+
+/**
+* Output sink that searches a text and delivers every match to a shared ring.
+*
+* @return Number of matches written
+*/
+std::size_t searchIntoMatchRing(const char* text, std::size_t n, const CompiledPattern& compiled,
+                                uint32_t patternId, SharedMatchRing& ring) {
+    std::size_t count = 0;
+    std::size_t m = compiled.pattern.length();
+    if (m > 0 && n >= m) {
+        scanBoyerMoore(text, compiled, 0, n - m, [&](std::size_t offset) {
+            pushMatch(ring, MatchRecord{offset, patternId, 0});
+            count++;
+        });
+    }
+    return count;
+}
+
+/**
+* Producer side of the ring demo: searches `path` for `pattern` and streams the matches
+* into the ring `name`, which must be drained by `--ring-consume` in another process.
+*/
+int produceMatchRing(const std::string& name, const std::string& pattern, const std::string& path) {
+    MappedFile corpus;
+    if (!mapFile(path, corpus)) {
+        std::cerr << "Cannot map " << path << std::endl;
+        return 1;
+    }
+    SharedMatchRing ring;
+    if (!createMatchRing(name, 1 << 16, ring)) {
+        std::cerr << "Cannot create shared ring " << name << std::endl;
+        unmapFile(corpus);
+        return 1;
+    }
+    std::size_t count = searchIntoMatchRing(corpus.data, corpus.size, compilePattern(pattern), 0, ring);
+    finishMatchRing(ring);
+    closeMatchRing(ring);
+    unmapFile(corpus);
+    std::cout << "Matches written to " << name << ": " << count << std::endl;
+    return 0;
+}
+
+// Consumer side of the ring demo: counts the records until the producer finishes, then removes the ring
+int consumeMatchRing(const std::string& name) {
+    SharedMatchRing ring;
+    while (!openMatchRing(name, ring)) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::size_t count = 0;
+    uint64_t lastOffset = 0;
+    MatchRecord record;
+    while (true) {
+        if (popMatch(ring, record)) {
+            count++;
+            lastOffset = record.offset;
+        } else if (matchRingDrained(ring)) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    closeMatchRing(ring);
+    shm_unlink(name.c_str());
+    std::cout << "Matches read from " << name << ": " << count;
+    if (count > 0) std::cout << "      - Last offset: " << lastOffset;
+    std::cout << std::endl;
+    return 0;
+}
+
+// =========================
+// Block Byte-Presence Summaries
+// =========================
+
+const std::size_t SUMMARY_BLOCK_SIZE = 64 * 1024;
+const uint32_t SUMMARY_MAGIC = 0x424d4232;  // "BMB2"
+const int64_t SUMMARY_RACY_SECONDS = 2;  // Files modified this recently are summarized but not saved
+const uint64_t SUMMARY_MIN_BLOCK_SIZE = 4096;  // Smallest block size a sidecar may claim
+
+// Set of byte values as a 256-bit bitmap
+struct ByteSet {
+    uint64_t words[4] = {};
+};
+
+void addByte(ByteSet& set, unsigned char c) {
+    set.words[c >> 6] |= uint64_t(1) << (c & 63);
+}
+
+// True when every byte of `required` is also in `present`
+bool containsAll(const ByteSet& present, const ByteSet& required) {
+    for (int w = 0; w < 4; w++) {
+        if ((required.words[w] & ~present.words[w]) != 0) return false;
+    }
+    return true;
+}
+
+/**
+* Sidecar summary of a large, mostly static file: for each block of `blockSize` bytes,
+* the set of byte values that occur in it. The device, inode, size and nanosecond
+* modification and status-change times identify the version of the file the summary
+* was built from, so a stale sidecar is detected (the status-change time also catches
+* a modification time set back by hand).
+*/
+struct BlockSummary {
+    uint64_t blockSize = SUMMARY_BLOCK_SIZE;
+    uint64_t fileSize = 0;
+    int64_t modifiedTime = 0;
+    int64_t modifiedNanos = 0;
+    int64_t changedTime = 0;
+    int64_t changedNanos = 0;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    std::vector<ByteSet> blocks;
+};
+
+void setSummaryFileVersion(BlockSummary& summary, const struct stat& info) {
+    summary.modifiedTime = info.st_mtim.tv_sec;
+    summary.modifiedNanos = info.st_mtim.tv_nsec;
+    summary.changedTime = info.st_ctim.tv_sec;
+    summary.changedNanos = info.st_ctim.tv_nsec;
+    summary.device = info.st_dev;
+    summary.inode = info.st_ino;
+}
+
+bool summaryMatchesFile(const BlockSummary& summary, const struct stat& info) {
+    return summary.fileSize == (uint64_t)info.st_size && summary.modifiedTime == (int64_t)info.st_mtim.tv_sec &&
+           summary.modifiedNanos == (int64_t)info.st_mtim.tv_nsec && summary.changedTime == (int64_t)info.st_ctim.tv_sec &&
+           summary.changedNanos == (int64_t)info.st_ctim.tv_nsec && summary.device == (uint64_t)info.st_dev &&
+           summary.inode == (uint64_t)info.st_ino;
+}
+
+BlockSummary buildBlockSummary(const char* text, std::size_t n, std::size_t blockSize = SUMMARY_BLOCK_SIZE) {
+    BlockSummary summary;
+    summary.blockSize = blockSize;
+    summary.fileSize = n;
+    summary.blocks.resize((n + blockSize - 1) / blockSize);
+    for (std::size_t i = 0; i < n; i++) {
+        addByte(summary.blocks[i / blockSize], (unsigned char)text[i]);
+    }
+    return summary;
+}
+
+bool saveBlockSummary(const std::string& path, const BlockSummary& summary) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    uint64_t blockCount = summary.blocks.size();
+    out.write(reinterpret_cast<const char*>(&SUMMARY_MAGIC), sizeof(SUMMARY_MAGIC));
+    out.write(reinterpret_cast<const char*>(&summary.blockSize), sizeof(summary.blockSize));
+    out.write(reinterpret_cast<const char*>(&summary.fileSize), sizeof(summary.fileSize));
+    out.write(reinterpret_cast<const char*>(&summary.modifiedTime), sizeof(summary.modifiedTime));
+    out.write(reinterpret_cast<const char*>(&summary.modifiedNanos), sizeof(summary.modifiedNanos));
+    out.write(reinterpret_cast<const char*>(&summary.changedTime), sizeof(summary.changedTime));
+    out.write(reinterpret_cast<const char*>(&summary.changedNanos), sizeof(summary.changedNanos));
+    out.write(reinterpret_cast<const char*>(&summary.device), sizeof(summary.device));
+    out.write(reinterpret_cast<const char*>(&summary.inode), sizeof(summary.inode));
+    out.write(reinterpret_cast<const char*>(&blockCount), sizeof(blockCount));
+    out.write(reinterpret_cast<const char*>(summary.blocks.data()), blockCount * sizeof(ByteSet));
+    return out.good();
+}
+
+/**
+* Loads the sidecar at `path` if it was built from the file described by `info`. The
+* sidecar is untrusted: its header is checked against the file, and its block size and
+* count against each other, before anything is allocated for the blocks.
+*
+* @return false if the sidecar is missing, malformed or stale
+*/
+bool loadBlockSummary(const std::string& path, const struct stat& info, BlockSummary& summary) {
+    std::ifstream in(path, std::ios::binary);
+    uint32_t magic = 0;
+    uint64_t blockCount = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&summary.blockSize), sizeof(summary.blockSize));
+    in.read(reinterpret_cast<char*>(&summary.fileSize), sizeof(summary.fileSize));
+    in.read(reinterpret_cast<char*>(&summary.modifiedTime), sizeof(summary.modifiedTime));
+    in.read(reinterpret_cast<char*>(&summary.modifiedNanos), sizeof(summary.modifiedNanos));
+    in.read(reinterpret_cast<char*>(&summary.changedTime), sizeof(summary.changedTime));
+    in.read(reinterpret_cast<char*>(&summary.changedNanos), sizeof(summary.changedNanos));
+    in.read(reinterpret_cast<char*>(&summary.device), sizeof(summary.device));
+    in.read(reinterpret_cast<char*>(&summary.inode), sizeof(summary.inode));
+    in.read(reinterpret_cast<char*>(&blockCount), sizeof(blockCount));
+    if (!in || magic != SUMMARY_MAGIC || !summaryMatchesFile(summary, info) ||
+        summary.blockSize < SUMMARY_MIN_BLOCK_SIZE ||
+        blockCount != summary.fileSize / summary.blockSize + (summary.fileSize % summary.blockSize != 0)) {
+        return false;
+    }
+    summary.blocks.resize(blockCount);
+    in.read(reinterpret_cast<char*>(summary.blocks.data()), blockCount * sizeof(ByteSet));
+    return in.good();
+}
+
+/**
+* Searches a text, skipping every block that cannot hold the start of a match. A match
+* starting in block `b` ends at most m-1 bytes later, so it lies in block `b` and the few
+* blocks covering those m-1 bytes; if their combined byte set lacks any byte of the pattern,
+* no alignment in block `b` can match. Runs of candidate blocks are scanned in one
+* `scanBoyerMoore` call, which reads past the last alignment of the run as needed.
+*
+* @param text Pointer to the text the summary was built from
+* @param n Length of the text
+* @param compiled The compiled pattern
+* @param summary Block summary of the text
+* @param skippedBlocks Receives the number of blocks that were never scanned
+* @return The starting offsets of every match in increasing order
+*/
+std::vector<std::size_t> findMatchesWithSummary(const char* text, std::size_t n, const CompiledPattern& compiled,
+                                                const BlockSummary& summary, std::size_t& skippedBlocks) {
+    std::vector<std::size_t> matches;
+    std::size_t m = compiled.pattern.length();
+    skippedBlocks = 0;
+    if (m == 0 || n < m) return matches;
+
+    ByteSet required;
+    for (char c : compiled.pattern) addByte(required, (unsigned char)c);
+
+    const std::size_t blockSize = summary.blockSize;
+    const std::size_t blockCount = summary.blocks.size();
+    const std::size_t lastShift = n - m;
+    auto onMatch = [&](std::size_t offset) { matches.push_back(offset); };
+
+    std::size_t runStart = 0;
+    bool inRun = false;
+    for (std::size_t b = 0; b * blockSize <= lastShift; b++) {
+        std::size_t lastBlock = std::min(blockCount - 1, ((b + 1) * blockSize - 1 + m - 1) / blockSize);
+        ByteSet present = summary.blocks[b];
+        for (std::size_t k = b + 1; k <= lastBlock; k++) {
+            for (int w = 0; w < 4; w++) present.words[w] |= summary.blocks[k].words[w];
+        }
+
+        bool candidate = containsAll(present, required);
+        if (candidate && !inRun) {
+            runStart = b * blockSize;
+            inRun = true;
+        } else if (!candidate) {
+            if (inRun) scanBoyerMoore(text, compiled, runStart, b * blockSize - 1, onMatch);
+            inRun = false;
+            skippedBlocks++;
+        }
+    }
+    if (inRun) scanBoyerMoore(text, compiled, runStart, lastShift, onMatch);
+    return matches;
+}
+
+/**
+* Searches a file using its sidecar summary `<path>.bmidx`, building or refreshing the
+* sidecar first when it is missing or was built from a different version of the file.
+* Timestamps only advance with the kernel clock tick, so a file modified in the last
+* SUMMARY_RACY_SECONDS could still change without its status changing; its summary is
+* used for this search but not saved.
+*/
+int searchIndexedFile(const std::string& pattern, const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    MappedFile file;
+    struct stat info;
+    bool mapped = fd >= 0 && fstat(fd, &info) == 0 && mapDescriptor(fd, info.st_size, file);
+    if (fd >= 0) close(fd);
+    if (!mapped) {
+        std::cerr << "Cannot map " << path << std::endl;
+        return 1;
+    }
+
+    std::string sidecarPath = path + ".bmidx";
+    BlockSummary summary;
+    if (!loadBlockSummary(sidecarPath, info, summary)) {
+        summary = buildBlockSummary(file.data, file.size);
+        setSummaryFileVersion(summary, info);
+        bool racy = time(nullptr) - (int64_t)std::max(info.st_mtim.tv_sec, info.st_ctim.tv_sec) < SUMMARY_RACY_SECONDS;
+        if (racy) {
+            unlink(sidecarPath.c_str());
+        } else if (!saveBlockSummary(sidecarPath, summary)) {
+            std::cerr << "Cannot write " << sidecarPath << std::endl;
+        }
+    }
+
+    std::size_t skippedBlocks = 0;
+    std::vector<std::size_t> matches =
+        findMatchesWithSummary(file.data, file.size, compilePattern(pattern), summary, skippedBlocks);
+    unmapFile(file);
+
+    std::cout << "Total Matches: " << matches.size() << std::endl;
+    std::cout << "Blocks skipped: " << skippedBlocks << " of " << summary.blocks.size() << std::endl;
+    return 0;
+}
+
+// =========================
+// Streaming Search
+// =========================
+//
+// Searches a stream of unknown length (a pipe, a socket) as its data arrives. Each read
+// lands behind the last m-1 bytes of the previous one, so matches that straddle a read
+// boundary are still found, and memory stays at two buffers however long the stream is.
+
+const std::size_t STREAM_CHUNK_SIZE = 8 * 1024 * 1024;
+
+/**
+* Reads up to `length` bytes, stopping early only at end of stream. The error is
+* returned rather than left in errno, which is per thread, so that a read run as an
+* asynchronous task can still report its cause.
+*
+* @return Bytes read (less than `length` only at end of stream), or -errno on error
+*/
+ssize_t readChunk(int fd, char* buffer, std::size_t length) {
+    std::size_t total = 0;
+    while (total < length) {
+        ssize_t got = read(fd, buffer + total, length - total);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) return -errno;
+        if (got == 0) break;
+        total += got;
+    }
+    return total;
+}
+
+// A single read of up to `length` bytes, retried on EINTR; 0 at end of stream, -errno on error
+ssize_t readAvailable(int fd, char* buffer, std::size_t length) {
+    while (true) {
+        ssize_t got = read(fd, buffer, length);
+        if (got >= 0) return got;
+        if (errno != EINTR) return -errno;
+    }
+}
+
+/**
+* Double-buffered search of a stream: whatever each read returns is searched at once,
+* while the next read waits for data in the other buffer on an asynchronous task. So
+* matches are reported as soon as the bytes that complete them arrive, however slowly
+* the stream delivers them, with offsets counted from the start of the stream.
+*
+* @param fd The stream to read until end of stream
+* @param compiled The compiled, non-empty pattern
+* @param onMatch Called with the absolute offset of every match, in order
+* @param chunkSize Most bytes requested per read; the two buffers hold chunkSize + m - 1 bytes each
+* @param onSearched Called after the bytes of each read have been searched, e.g. to flush output
+* @return 0, or the errno of the read that failed; matches found before the failure
+*         have been reported
+*/
+template <typename OnMatch, typename OnSearched = void (*)()>
+int searchStream(int fd, const CompiledPattern& compiled, OnMatch&& onMatch,
+                 std::size_t chunkSize = STREAM_CHUNK_SIZE, OnSearched onSearched = []() {}) {
+    const std::size_t m = compiled.pattern.length();
+    const std::size_t reserve = m - 1;  // Room in front of each read for the previous tail
+    std::vector<char> buffers[2] = {std::vector<char>(reserve + chunkSize), std::vector<char>(reserve + chunkSize)};
+
+    int current = 0;
+    ssize_t got = readAvailable(fd, buffers[current].data() + reserve, chunkSize);
+    std::size_t carry = 0;  // Tail of the previous window, just in front of this read
+    uint64_t base = 0;      // Stream offset of the first byte of the window
+
+    while (got > 0) {
+        const char* window = buffers[current].data() + reserve - carry;
+        const std::size_t length = carry + got;
+
+        std::future<ssize_t> next =
+            std::async(std::launch::async, readAvailable, fd, buffers[1 - current].data() + reserve, chunkSize);
+        if (length >= m) {
+            scanBoyerMoore(window, compiled, 0, length - m, [&](std::size_t offset) { onMatch(base + offset); });
+        }
+        onSearched();
+
+        // The next read fills the other buffer from `reserve` on, so the tail can go in front of it meanwhile
+        std::size_t tail = std::min(reserve, length);
+        std::memcpy(buffers[1 - current].data() + reserve - tail, window + length - tail, tail);
+        base += length - tail;
+        carry = tail;
+        current = 1 - current;
+        got = next.get();
+    }
+    return got < 0 ? -got : 0;
+}
+
+/**
+* Pipeline mode: searches standard input for `pattern`, printing each match offset on
+* its own line while the stream is still being read, then the total on stderr.
+*/
+int searchStandardInput(const std::string& pattern) {
+    if (pattern.empty()) {
+        std::cerr << "Empty pattern" << std::endl;
+        return 1;
+    }
+    std::size_t count = 0;
+    int error = searchStream(
+        STDIN_FILENO, compilePattern(pattern),
+        [&](uint64_t offset) {
+            std::cout << offset << '\n';
+            count++;
+        },
+        STREAM_CHUNK_SIZE, []() { std::cout.flush(); });
+    if (error != 0) {
+        std::cerr << "Read error on standard input: " << std::strerror(error) << std::endl;
+        return 1;
+    }
+    std::cerr << "Total Matches: " << count << std::endl;
+    return 0;
+}
+
+// =========================
+// Incremental Search
+// =========================
+//
+// Searches text that only ever grows, such as a log file. The searcher keeps the last
+// m-1 bytes it has seen; each append scans only the new bytes, plus the alignments that
+// start in that kept tail and end in the new bytes.
+
+/**
+* State of an incremental search. `consumed` is the number of bytes appended so far,
+* which is also the absolute offset of the next byte to arrive.
+*/
+struct IncrementalSearcher {
+    CompiledPattern compiled;
+    std::string tail;  // The last min(m-1, consumed) bytes
+    uint64_t consumed = 0;
+    std::size_t matchCount = 0;
+    uint64_t device = 0;  // File the consumed bytes came from, as set by `searchLogTail`
+    uint64_t inode = 0;
+};
+
+IncrementalSearcher openIncrementalSearch(const std::string& pattern) {
+    IncrementalSearcher searcher;
+    searcher.compiled = compilePattern(pattern);
+    return searcher;
+}
+
+// Forgets all text seen so far, e.g. after the file was truncated or rotated
+void resetIncrementalSearch(IncrementalSearcher& searcher) {
+    searcher.tail.clear();
+    searcher.consumed = 0;
+}
+
+/**
+* Scans bytes that continue a text of which only the last min(m-1, consumed) bytes are
+* kept in `tail`, and reports the matches that end in the new bytes. The alignments
+* straddling the old end are scanned in `tail` itself, with the first m-1 new bytes
+* appended to it; the rest of the new bytes are scanned in place. `tail` and `consumed`
+* are then advanced past the new bytes.
+*
+* @param onMatch Called with the absolute offset of every new match, in order
+*/
+template <typename OnMatch>
+void scanContinuation(const CompiledPattern& compiled, std::string& tail, uint64_t& consumed,
+                      const char* data, std::size_t length, OnMatch&& onMatch) {
+    const std::size_t m = compiled.pattern.length();
+    if (m == 0 || length == 0) return;
+
+    const std::size_t keep = m - 1;
+    const std::size_t kept = tail.size();
+    if (kept > 0) {
+        tail.append(data, std::min(keep, length));
+        if (tail.size() >= m) {
+            uint64_t base = consumed - kept;
+            scanBoyerMoore(tail.data(), compiled, 0, std::min(kept - 1, tail.size() - m),
+                           [&](std::size_t offset) { onMatch(base + offset); });
+        }
+    }
+    if (length >= m) {
+        uint64_t base = consumed;
+        scanBoyerMoore(data, compiled, 0, length - m, [&](std::size_t offset) { onMatch(base + offset); });
+    }
+
+    if (length >= keep) {
+        tail.assign(data + length - keep, keep);
+    } else {
+        tail.resize(kept);
+        tail.append(data, length);
+        tail.erase(0, tail.size() - std::min(tail.size(), keep));
+    }
+    consumed += length;
+}
+
+// Appends bytes to the searched text and reports the matches that end in them
+template <typename OnMatch>
+void appendText(IncrementalSearcher& searcher, const char* data, std::size_t length, OnMatch&& onMatch) {
+    scanContinuation(searcher.compiled, searcher.tail, searcher.consumed, data, length, [&](uint64_t offset) {
+        searcher.matchCount++;
+        onMatch(offset);
+    });
+}
+
+/**
+* Feeds the bytes appended to `path` since the last call into the searcher, reading
+* from `searcher.consumed` to the current end of file. A file that is no longer the one
+* the consumed bytes came from (another device or inode: rotated, or replaced by a
+* rename) or is shorter than what was consumed (truncated) is searched again from the
+* start.
+*
+* @return false if the file cannot be opened or read
+*/
+template <typename OnMatch>
+bool searchLogTail(const std::string& path, IncrementalSearcher& searcher, OnMatch&& onMatch) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    bool replaced = searcher.consumed > 0 &&
+                    (searcher.device != (uint64_t)info.st_dev || searcher.inode != (uint64_t)info.st_ino);
+    if (replaced || (uint64_t)info.st_size < searcher.consumed) resetIncrementalSearch(searcher);
+    searcher.device = info.st_dev;
+    searcher.inode = info.st_ino;
+    if ((uint64_t)info.st_size == searcher.consumed || lseek(fd, searcher.consumed, SEEK_SET) < 0) {
+        close(fd);
+        return (uint64_t)info.st_size == searcher.consumed;
+    }
+
+    std::vector<char> buffer(std::min<uint64_t>(STREAM_CHUNK_SIZE, info.st_size - searcher.consumed));
+    while (true) {
+        ssize_t got = readChunk(fd, buffer.data(), buffer.size());
+        if (got < 0) {
+            close(fd);
+            return false;
+        }
+        appendText(searcher, buffer.data(), got, onMatch);
+        if ((std::size_t)got < buffer.size()) break;
+    }
+    close(fd);
+    return true;
+}
+
+/**
+* Follow mode: like `tail -f`, polls `path` every second and prints the offset of each
+* new match of `pattern`, never rescanning bytes already searched. Runs until killed.
+*/
+int followLogFile(const std::string& pattern, const std::string& path) {
+    if (pattern.empty()) {
+        std::cerr << "Empty pattern" << std::endl;
+        return 1;
+    }
+    IncrementalSearcher searcher = openIncrementalSearch(pattern);
+    while (true) {
+        if (!searchLogTail(path, searcher, [](uint64_t offset) { std::cout << offset << '\n'; })) {
+            std::cerr << "Cannot read " << path << std::endl;
+        }
+        std::cout.flush();
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+// =========================
+// Segmented Text
+// =========================
+//
+// Searches a text held as a chain of non-contiguous buffers (iovec-style) without
+// flattening it. Each segment's interior is scanned in place; only the alignments that
+// straddle a boundary go through a stitch buffer of at most 2(m-1) bytes.
+
+struct TextSegment {
+    const char* data;
+    std::size_t length;
+};
+
+/**
+* Scans the concatenation of `segments` in order, reporting offsets counted from the
+* start of the first segment. Empty segments are allowed.
+*
+* @param onMatch Called with the offset of every match, in order
+*/
+template <typename OnMatch>
+void scanSegments(const TextSegment* segments, std::size_t count, const CompiledPattern& compiled,
+                  OnMatch&& onMatch) {
+    std::string stitch;
+    stitch.reserve(2 * compiled.pattern.length());
+    uint64_t consumed = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        scanContinuation(compiled, stitch, consumed, segments[i].data, segments[i].length, onMatch);
+    }
+}
+
+std::vector<std::size_t> findMatchesSegmented(const std::vector<TextSegment>& segments,
+                                              const CompiledPattern& compiled) {
+    std::vector<std::size_t> matches;
+    scanSegments(segments.data(), segments.size(), compiled, [&](uint64_t offset) { matches.push_back(offset); });
+    return matches;
+}
+
+// =========================
+// Edit-Aware Re-Search
+// =========================
+//
+// Keeps the match set of an edited document up to date. Only alignments that overlap
+// the edit can change: matches entirely before it are kept, matches entirely after it
+// move by the change in length, and the alignments in between are scanned again.
+
+// Replaces `removedLength` bytes at `offset` with `insertedBytes`
+struct TextEdit {
+    std::size_t offset = 0;
+    std::size_t removedLength = 0;
+    std::string insertedBytes;
+};
+
+// Applies the edit to `text`. Returns false if it reaches past the end of the text.
+bool applyTextEdit(std::string& text, const TextEdit& edit) {
+    if (edit.offset > text.size() || edit.removedLength > text.size() - edit.offset) return false;
+    text.replace(edit.offset, edit.removedLength, edit.insertedBytes);
+    return true;
+}
+
+/**
+* Updates the sorted match offsets of a text after one edit, scanning only the window
+* [offset - m + 1, offset + inserted + m - 1) of the edited text.
+*
+* @param text The text after the edit
+* @param n Its length
+* @param compiled The pattern the matches belong to
+* @param edit The edit that was applied
+* @param matches The sorted matches before the edit; receives the matches after it
+* @return false if the edit does not fit the edited text (`matches` is then unchanged)
+*/
+bool researchAfterEdit(const char* text, std::size_t n, const CompiledPattern& compiled, const TextEdit& edit,
+                       std::vector<std::size_t>& matches) {
+    const std::size_t m = compiled.pattern.length();
+    const std::size_t inserted = edit.insertedBytes.length();
+    if (m == 0 || edit.offset > n || inserted > n - edit.offset) return false;
+
+    // Unaffected matches end at or before the edit, or start at or after the removed bytes
+    const std::size_t firstShift = edit.offset + 1 > m ? edit.offset + 1 - m : 0;
+    auto firstTouched = std::lower_bound(matches.begin(), matches.end(), firstShift);
+    auto firstAfter = std::lower_bound(firstTouched, matches.end(), edit.offset + edit.removedLength);
+
+    std::vector<std::size_t> updated(matches.begin(), firstTouched);
+    std::size_t editEnd = edit.offset + inserted;
+    if (editEnd > 0 && n >= m) {
+        std::size_t lastShift = std::min(editEnd - 1, n - m);
+        if (firstShift <= lastShift) {
+            scanBoyerMoore(text, compiled, firstShift, lastShift,
+                           [&](std::size_t offset) { updated.push_back(offset); });
+        }
+    }
+    for (auto it = firstAfter; it != matches.end(); ++it) updated.push_back(*it - edit.removedLength + inserted);
+    matches.swap(updated);
+    return true;
+}
+
+// =========================
+// Character-Class Patterns
+// =========================
+//
+// Patterns whose positions are sets of bytes, written with literal bytes, `.` for any
+// byte, `[...]` classes with ranges such as [ACGT] or [0-9a-f], and `\` to escape the
+// next byte. Each position is kept as a 256-bit membership mask.
+
+bool hasByte(const ByteSet& set, unsigned char c) {
+    return (set.words[c >> 6] >> (c & 63)) & 1;
+}
+
+bool isEmpty(const ByteSet& set) {
+    return (set.words[0] | set.words[1] | set.words[2] | set.words[3]) == 0;
+}
+
+// True when some byte belongs to both sets
+bool intersects(const ByteSet& a, const ByteSet& b) {
+    for (int w = 0; w < 4; w++) {
+        if ((a.words[w] & b.words[w]) != 0) return true;
+    }
+    return false;
+}
+
+struct CompiledClassPattern {
+    std::vector<ByteSet> positions;
+    std::vector<int> badCharTable;
+    std::vector<int> goodSuffixShifts;
+};
+
+/**
+* Parses a class pattern such as "ID-[0-9][0-9]" into one byte set per position.
+*
+* @return false when a class is unterminated, empty or holds a reversed range such as
+*         [z-a], or the pattern ends with `\`
+*/
+bool parseClassPattern(const std::string& spec, std::vector<ByteSet>& positions) {
+    positions.clear();
+    for (std::size_t i = 0; i < spec.length(); i++) {
+        ByteSet set;
+        char c = spec[i];
+        if (c == '\\') {
+            if (++i == spec.length()) return false;
+            addByte(set, spec[i]);
+        } else if (c == '.') {
+            for (int w = 0; w < 4; w++) set.words[w] = ~uint64_t(0);
+        } else if (c == '[') {
+            std::size_t close = spec.find(']', i + 2);  // A leading ']' is a member
+            if (close == std::string::npos || close == i + 1) return false;
+            for (std::size_t k = i + 1; k < close; k++) {
+                unsigned char low = spec[k];
+                unsigned char high = low;
+                if (k + 2 < close && spec[k + 1] == '-') {
+                    high = spec[k + 2];
+                    k += 2;
+                }
+                if (high < low) return false;
+                for (int b = low; b <= high; b++) addByte(set, b);
+            }
+            if (isEmpty(set)) return false;
+            i = close;
+        } else {
+            addByte(set, c);
+        }
+        positions.push_back(set);
+    }
+    return true;
+}
+
+/**
+* Preprocesses a class pattern for the bad character heuristic: for every byte `c`,
+* the last position whose class contains `c`, or -1 if no class does.
+*/
+void precomputeClassBadCharacterTable(const std::vector<ByteSet>& positions, std::vector<int>& badCharTable) {
+    badCharTable.assign(NUM_CHARS, -1);
+    for (int i = 0; i < (int)positions.size(); ++i) {
+        for (int c = 0; c < NUM_CHARS; c++) {
+            if (hasByte(positions[i], c)) badCharTable[c] = i;
+        }
+    }
+}
+
+/**
+* Preprocesses a class pattern for the good suffix heuristic. With classes, the text
+* that matched a suffix is only known position by position to lie in the suffix's
+* classes, so a shift `s` is safe when each class of the suffix overlaps the class that
+* lands on it after shifting. For every shift the rightmost position where that fails is
+* recorded, and `goodSuffixShifts[k]` (suffix of length m-k) is the smallest shift whose
+* failures all lie left of `k`. O(m^2) set intersections, fine for the short patterns
+* class lists use.
+*/
+void precomputeClassGoodSuffixTable(const std::vector<ByteSet>& positions, std::vector<int>& goodSuffixShifts) {
+    int m = positions.size();
+    // lastConflict[s]: rightmost i with class i and class i-s disjoint, or -1
+    std::vector<int> lastConflict(m + 1, -1);
+    for (int s = 1; s < m; s++) {
+        for (int i = m - 1; i >= s; i--) {
+            if (!intersects(positions[i], positions[i - s])) {
+                lastConflict[s] = i;
+                break;
+            }
+        }
+    }
+
+    goodSuffixShifts.assign(m + 1, m);
+    int s = 1;
+    for (int k = m; k >= 0; k--) {
+        // A longer suffix only adds constraints, so the smallest safe shift never decreases
+        while (s < m && lastConflict[s] >= k) s++;
+        goodSuffixShifts[k] = s;
+    }
+}
+
+bool compileClassPattern(const std::string& spec, CompiledClassPattern& compiled) {
+    if (!parseClassPattern(spec, compiled.positions) || compiled.positions.empty()) return false;
+    precomputeClassBadCharacterTable(compiled.positions, compiled.badCharTable);
+    precomputeClassGoodSuffixTable(compiled.positions, compiled.goodSuffixShifts);
+    return true;
+}
+
+/**
+* Searches a text for a class pattern with the Boyer-Moore loop; each comparison is a
+* lookup of the text byte in the position's membership mask.
+*
+* @return The starting offsets of every match in increasing order
+*/
+std::vector<std::size_t> findClassMatches(const char* text, std::size_t n, const CompiledClassPattern& compiled) {
+    std::vector<std::size_t> matches;
+    const std::vector<ByteSet>& positions = compiled.positions;
+    const int m = positions.size();
+    if (m == 0 || n < (std::size_t)m) return matches;
+
+    std::size_t shift = 0;
+    while (shift <= n - m) {
+        int j = m - 1;
+        while (j >= 0 && hasByte(positions[j], text[shift + j])) j--;
+
+        if (j < 0) {
+            matches.push_back(shift);
+            shift += compiled.goodSuffixShifts[0];
+        } else {
+            int badCharShift = j - compiled.badCharTable[(unsigned char)text[shift + j]];
+            shift += std::max(badCharShift, compiled.goodSuffixShifts[j + 1]);
+        }
+    }
+    return matches;
+}
+
+int searchClassPatternFile(const std::string& spec, const std::string& path) {
+    CompiledClassPattern compiled;
+    if (!compileClassPattern(spec, compiled)) {
+        std::cerr << "Invalid class pattern: " << spec << std::endl;
+        return 1;
+    }
+    MappedFile file;
+    if (!mapFile(path, file)) {
+        std::cerr << "Cannot map " << path << std::endl;
+        return 1;
+    }
+    std::vector<std::size_t> matches = findClassMatches(file.data, file.size, compiled);
+    unmapFile(file);
+    std::cout << "Total Matches: " << matches.size() << std::endl;
+    return 0;
+}
+
+// =========================
+// Multi-Pattern Search (Wu-Manber)
+// =========================
+
+struct MultiMatch {
+    std::size_t offset;  // Starting offset of the match in the text
+    uint32_t patternId;  // Index of the pattern in the set
+};
+
+/**
+* Wu-Manber tables for a set of patterns. All patterns are treated as if they were as
+* long as the shortest one (`minLength`) and read in blocks of `blockSize` bytes:
+* `shiftTable[h]` is how far the window may move when the block ending it hashes to `h`.
+* A zero shift means some pattern's first `minLength` bytes end with that block; those
+* patterns are listed in bucket `h` (`bucketStart[h]` .. `bucketStart[h+1]`, a flat
+* array rather than lists) together with their two-byte prefix, used to filter candidates
+* before the full verification.
+*/
+struct WuManberTable {
+    int minLength = 0;
+    int blockSize = 0;
+    int hashBits = 0;
+    std::vector<uint16_t> shiftTable;
+    std::vector<uint32_t> bucketStart;
+    std::vector<uint32_t> bucketPatterns;
+    std::vector<uint16_t> bucketPrefixes;
+};
+
+const std::size_t WU_MANBER_LARGE_SET = 1024;  // Sets this large use 3-byte blocks
+
+uint32_t hashBlock(const char* block, int blockSize, int hashBits) {
+    uint32_t value = 0;
+    for (int k = 0; k < blockSize; k++) value = (value << 8) | (unsigned char)block[k];
+    if (blockSize * 8 <= hashBits) return value;
+    return (value * 2654435761u) >> (32 - hashBits);
+}
+
+uint16_t prefixKey(const char* text, int minLength) {
+    uint16_t key = (unsigned char)text[0];
+    if (minLength > 1) key = (key << 8) | (unsigned char)text[1];
+    return key;
+}
+
+/**
+* Builds the Wu-Manber tables. Two-byte blocks index the shift table directly; sets of
+* WU_MANBER_LARGE_SET patterns or more use three-byte blocks hashed to 18 bits, which
+* keeps most blocks absent from the set and the average shift long.
+*
+* @param patterns The pattern set (no empty patterns)
+* @param table A reference to the tables to be built
+*/
+void buildWuManber(const std::vector<std::string>& patterns, WuManberTable& table) {
+    std::size_t minLength = patterns[0].length();
+    for (const std::string& pattern : patterns) minLength = std::min(minLength, pattern.length());
+
+    table.minLength = minLength;
+    table.blockSize = std::min<int>(minLength, patterns.size() >= WU_MANBER_LARGE_SET ? 3 : 2);
+    table.hashBits = table.blockSize == 3 ? 18 : table.blockSize * 8;
+    const int lastBlockEnd = table.minLength - 1;
+    const std::size_t tableSize = std::size_t(1) << table.hashBits;
+    const int defaultShift = std::min(table.minLength - table.blockSize + 1, 0xffff);
+    table.shiftTable.assign(tableSize, defaultShift);
+
+    std::vector<uint32_t> bucketOf(patterns.size());
+    table.bucketStart.assign(tableSize + 1, 0);
+    for (std::size_t id = 0; id < patterns.size(); id++) {
+        const char* pattern = patterns[id].data();
+        for (int end = table.blockSize - 1; end <= lastBlockEnd; end++) {
+            uint32_t hash = hashBlock(pattern + end - table.blockSize + 1, table.blockSize, table.hashBits);
+            int shift = std::min(lastBlockEnd - end, 0xffff);
+            if (shift < table.shiftTable[hash]) table.shiftTable[hash] = shift;
+        }
+        bucketOf[id] = hashBlock(pattern + lastBlockEnd - table.blockSize + 1, table.blockSize, table.hashBits);
+        table.bucketStart[bucketOf[id] + 1]++;
+    }
+
+    // Counting sort of pattern ids by bucket
+    for (std::size_t h = 0; h < tableSize; h++) table.bucketStart[h + 1] += table.bucketStart[h];
+    table.bucketPatterns.resize(patterns.size());
+    table.bucketPrefixes.resize(patterns.size());
+    std::vector<uint32_t> fill(table.bucketStart.begin(), table.bucketStart.end() - 1);
+    for (std::size_t id = 0; id < patterns.size(); id++) {
+        uint32_t slot = fill[bucketOf[id]]++;
+        table.bucketPatterns[slot] = id;
+        table.bucketPrefixes[slot] = prefixKey(patterns[id].data(), table.minLength);
+    }
+}
+
+/**
+* Wu-Manber scan: the window of `minLength` bytes moves by the shift of its last block;
+* at a zero shift, the patterns of that block's bucket whose prefix agrees with the text
+* are verified with `verifyMatch`, the same routine the single-pattern kernels use.
+*
+* @param onMatch Called with (offset, pattern id) for every match, in offset order
+*/
+template <typename OnMatch>
+void scanWuManber(const char* text, std::size_t n, const std::vector<std::string>& patterns,
+                  const WuManberTable& table, OnMatch&& onMatch) {
+    const std::size_t minLength = table.minLength;
+    if (minLength == 0 || n < minLength) return;
+
+    std::size_t end = minLength - 1;  // Last byte of the current window
+    while (end < n) {
+        uint32_t hash = hashBlock(text + end - table.blockSize + 1, table.blockSize, table.hashBits);
+        uint16_t shift = table.shiftTable[hash];
+        if (shift > 0) {
+            end += shift;
+            continue;
+        }
+
+        std::size_t start = end + 1 - minLength;
+        uint16_t prefix = prefixKey(text + start, table.minLength);
+        for (uint32_t slot = table.bucketStart[hash]; slot < table.bucketStart[hash + 1]; slot++) {
+            if (table.bucketPrefixes[slot] != prefix) continue;
+            uint32_t id = table.bucketPatterns[slot];
+            const std::string& pattern = patterns[id];
+            if (start + pattern.length() <= n && verifyMatch(text + start, pattern.data(), pattern.length())) {
+                onMatch(start, id);
+            }
+        }
+        end++;
+    }
+}
+
+const int AHO_CORASICK_DENSE_DEPTH = 2;  // States shallower than this get a full transition row
+
+/**
+* Aho-Corasick automaton in a compact layout. States are numbered breadth-first, so the
+* root and the states one byte deep, where the scan spends nearly all its time, come
+* first (`0` .. `denseStates-1`) and have dense 256-entry rows with the fail links already
+* folded in: one load per byte. Every deeper state keeps only its real edges, as
+* (label, target) pairs stored next to each other and sorted by label in one flat array
+* (`edgeStart[s]` .. `edgeStart[s+1]`), so a lookup reads one or two cache lines; missing
+* edges follow `fail` links until a dense row answers. `outputStart` lists the patterns
+* ending at each state, and `outputLink` jumps to the nearest state on the fail chain that
+* has output; `reportState` is the state itself when it has output and its `outputLink`
+* otherwise, so the scan tests one word per byte.
+*/
+struct AhoCorasickEdge {
+    unsigned char label;
+    uint32_t target;
+};
+
+struct AhoCorasickAutomaton {
+    uint32_t denseStates = 0;
+    std::vector<uint32_t> denseNext;
+    std::vector<uint32_t> edgeStart;
+    std::vector<AhoCorasickEdge> edges;
+    std::vector<uint32_t> fail;
+    std::vector<uint32_t> outputStart;
+    std::vector<uint32_t> outputPatterns;
+    std::vector<uint32_t> outputLink;  // 0 when no state on the fail chain has output
+    std::vector<uint32_t> reportState;
+};
+
+// Target of the edge labelled `c` leaving `state`, or 0 when there is none
+uint32_t findEdge(const AhoCorasickAutomaton& automaton, uint32_t state, unsigned char c) {
+    const AhoCorasickEdge* edge = automaton.edges.data() + automaton.edgeStart[state];
+    const AhoCorasickEdge* end = automaton.edges.data() + automaton.edgeStart[state + 1];
+    for (; edge != end && edge->label <= c; ++edge) {
+        if (edge->label == c) return edge->target;
+    }
+    return 0;
+}
+
+// Every fail chain ends at the root, which always has a dense row
+uint32_t nextState(const AhoCorasickAutomaton& automaton, uint32_t state, unsigned char c) {
+    for (;;) {
+        if (state < automaton.denseStates) return automaton.denseNext[state * NUM_CHARS + c];
+        uint32_t target = findEdge(automaton, state, c);
+        if (target != 0) return target;
+        state = automaton.fail[state];
+    }
+}
+
+/**
+* Builds the automaton: a trie of the patterns, renumbered breadth-first and flattened
+* into the compact layout, then dense rows, fail and output links in state order (a
+* state's fail target is always shallower, hence already resolved).
+*
+* @param patterns The pattern set (no empty patterns)
+* @param automaton A reference to the automaton to be built
+*/
+void buildAhoCorasick(const std::vector<std::string>& patterns, AhoCorasickAutomaton& automaton) {
+    // Trie with per-state edge lists, only used during construction
+    std::vector<std::vector<AhoCorasickEdge>> trie(1);
+    std::vector<std::vector<uint32_t>> ends(1);
+    for (uint32_t id = 0; id < patterns.size(); id++) {
+        uint32_t state = 0;
+        for (char ch : patterns[id]) {
+            unsigned char c = ch;
+            uint32_t target = 0;
+            for (const AhoCorasickEdge& edge : trie[state]) {
+                if (edge.label == c) target = edge.target;
+            }
+            if (target == 0) {
+                target = trie.size();
+                trie[state].push_back(AhoCorasickEdge{c, target});
+                trie.emplace_back();
+                ends.emplace_back();
+            }
+            state = target;
+        }
+        ends[state].push_back(id);
+    }
+
+    // Breadth-first order, with edges sorted by label
+    const std::size_t states = trie.size();
+    std::vector<uint32_t> order(1, 0);
+    std::vector<uint32_t> renumbered(states, 0);
+    std::vector<int> depth(1, 0);
+    automaton.denseStates = 0;
+    for (std::size_t head = 0; head < order.size(); head++) {
+        std::vector<AhoCorasickEdge>& children = trie[order[head]];
+        std::sort(children.begin(), children.end(),
+                  [](const AhoCorasickEdge& a, const AhoCorasickEdge& b) { return a.label < b.label; });
+        if (depth[head] < AHO_CORASICK_DENSE_DEPTH) automaton.denseStates++;
+        for (const AhoCorasickEdge& edge : children) {
+            renumbered[edge.target] = order.size();
+            order.push_back(edge.target);
+            depth.push_back(depth[head] + 1);
+        }
+    }
+
+    automaton.edgeStart.assign(states + 1, 0);
+    automaton.edges.clear();
+    automaton.outputStart.assign(states + 1, 0);
+    automaton.outputPatterns.clear();
+    for (std::size_t s = 0; s < states; s++) {
+        automaton.edgeStart[s] = automaton.edges.size();
+        for (const AhoCorasickEdge& edge : trie[order[s]]) {
+            automaton.edges.push_back(AhoCorasickEdge{edge.label, renumbered[edge.target]});
+        }
+        automaton.outputStart[s] = automaton.outputPatterns.size();
+        const std::vector<uint32_t>& ids = ends[order[s]];
+        automaton.outputPatterns.insert(automaton.outputPatterns.end(), ids.begin(), ids.end());
+    }
+    automaton.edgeStart[states] = automaton.edges.size();
+    automaton.outputStart[states] = automaton.outputPatterns.size();
+
+    automaton.fail.assign(states, 0);
+    automaton.outputLink.assign(states, 0);
+    automaton.reportState.assign(states, 0);
+    automaton.denseNext.assign(std::size_t(automaton.denseStates) * NUM_CHARS, 0);
+    for (uint32_t state = 0; state < states; state++) {
+        if (state < automaton.denseStates) {
+            uint32_t* row = automaton.denseNext.data() + std::size_t(state) * NUM_CHARS;
+            if (state != 0) {
+                for (int c = 0; c < NUM_CHARS; c++) row[c] = nextState(automaton, automaton.fail[state], c);
+            }
+            for (uint32_t k = automaton.edgeStart[state]; k < automaton.edgeStart[state + 1]; k++) {
+                row[automaton.edges[k].label] = automaton.edges[k].target;
+            }
+        }
+        for (uint32_t k = automaton.edgeStart[state]; k < automaton.edgeStart[state + 1]; k++) {
+            uint32_t child = automaton.edges[k].target;
+            uint32_t failTarget = state == 0 ? 0 : nextState(automaton, automaton.fail[state], automaton.edges[k].label);
+            automaton.fail[child] = failTarget;
+            bool failHasOutput = automaton.outputStart[failTarget] != automaton.outputStart[failTarget + 1];
+            automaton.outputLink[child] = failHasOutput ? failTarget : automaton.outputLink[failTarget];
+            bool hasOutput = automaton.outputStart[child] != automaton.outputStart[child + 1];
+            automaton.reportState[child] = hasOutput ? child : automaton.outputLink[child];
+        }
+    }
+}
+
+/**
+* Runs the automaton over the text, one transition per byte, and reports every pattern
+* ending at each position.
+*
+* @param onMatch Called with (offset, pattern id) for every match, in order of match end
+*/
+template <typename OnMatch>
+void scanAhoCorasick(const char* text, std::size_t n, const std::vector<std::string>& patterns,
+                     const AhoCorasickAutomaton& automaton, OnMatch&& onMatch) {
+    uint32_t state = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        state = nextState(automaton, state, text[i]);
+        for (uint32_t s = automaton.reportState[state]; s != 0; s = automaton.outputLink[s]) {
+            for (uint32_t k = automaton.outputStart[s]; k < automaton.outputStart[s + 1]; k++) {
+                uint32_t id = automaton.outputPatterns[k];
+                onMatch(i + 1 - patterns[id].length(), id);
+            }
+        }
+    }
+}
+
+enum class MultiPatternEngine { WuManber, AhoCorasick };
+
+const int AHO_CORASICK_MIN_LENGTH = 3;            // Shorter patterns cap Wu-Manber shifts at 0-1 bytes
+const double AHO_CORASICK_MIN_EXPECTED_SHIFT = 1.0;  // Below this expected shift, skipping does not pay
+const int SHIFT_SAMPLES = 4096;
+
+// xorshift32: a small deterministic generator for sampling and the self-test
+uint32_t nextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/**
+* Estimates the average Wu-Manber shift on text that looks like the patterns: blocks
+* are sampled with each byte drawn from the bytes of the set, so a small alphabet
+* (DNA, digits) counts against skipping even when most of the hashed table is unused.
+*/
+double expectedWuManberShift(const std::vector<std::string>& patterns, const WuManberTable& table) {
+    std::string bytes;
+    for (const std::string& pattern : patterns) bytes += pattern;
+
+    uint32_t state = 2463534242u;  // Fixed seed so planning is deterministic
+    double shiftSum = 0;
+    char block[4];
+    for (int sample = 0; sample < SHIFT_SAMPLES; sample++) {
+        for (int k = 0; k < table.blockSize; k++) block[k] = bytes[nextRandom(state) % bytes.size()];
+        shiftSum += table.shiftTable[hashBlock(block, table.blockSize, table.hashBits)];
+    }
+    return shiftSum / SHIFT_SAMPLES;
+}
+
+const char* multiEngineName(MultiPatternEngine engine) {
+    return engine == MultiPatternEngine::WuManber ? "Wu-Manber" : "Aho-Corasick";
+}
+
+/**
+* A set of patterns compiled for multi-pattern search; matches report the index of
+* the pattern in `patterns`. Only the tables of the chosen engine are kept.
+*/
+struct CompiledPatternSet {
+    std::vector<std::string> patterns;
+    MultiPatternEngine engine = MultiPatternEngine::WuManber;
+    WuManberTable wuManber;
+    AhoCorasickAutomaton ahoCorasick;
+};
+
+/**
+* Compiles a pattern set and chooses its engine. Wu-Manber can never shift further than
+* the shortest pattern allows, and with large sets over a small alphabet most blocks
+* occur somewhere, so most shifts collapse. Aho-Corasick is chosen when the shortest
+* pattern is under AHO_CORASICK_MIN_LENGTH bytes or when the expected Wu-Manber shift
+* is under AHO_CORASICK_MIN_EXPECTED_SHIFT.
+*
+* @return false for an empty set or a set containing an empty pattern
+*/
+bool compilePatternSet(const std::vector<std::string>& patterns, CompiledPatternSet& compiled) {
+    if (patterns.empty()) return false;
+    for (const std::string& pattern : patterns) {
+        if (pattern.empty()) return false;
+    }
+    compiled.patterns = patterns;
+    buildWuManber(compiled.patterns, compiled.wuManber);
+
+    if (compiled.wuManber.minLength < AHO_CORASICK_MIN_LENGTH ||
+        expectedWuManberShift(compiled.patterns, compiled.wuManber) < AHO_CORASICK_MIN_EXPECTED_SHIFT) {
+        compiled.engine = MultiPatternEngine::AhoCorasick;
+        compiled.wuManber = WuManberTable();
+        buildAhoCorasick(compiled.patterns, compiled.ahoCorasick);
+    } else {
+        compiled.engine = MultiPatternEngine::WuManber;
+    }
+    return true;
+}
+
+// Every occurrence of every pattern of the set, ordered by offset
+std::vector<MultiMatch> findPatternSet(const char* text, std::size_t n, const CompiledPatternSet& compiled) {
+    std::vector<MultiMatch> matches;
+    auto onMatch = [&](std::size_t offset, uint32_t id) { matches.push_back(MultiMatch{offset, id}); };
+    if (compiled.engine == MultiPatternEngine::WuManber) {
+        scanWuManber(text, n, compiled.patterns, compiled.wuManber, onMatch);
+        return matches;
+    }
+
+    // Aho-Corasick reports matches by their end; order them by start like Wu-Manber
+    scanAhoCorasick(text, n, compiled.patterns, compiled.ahoCorasick, onMatch);
+    std::stable_sort(matches.begin(), matches.end(),
+                     [](const MultiMatch& a, const MultiMatch& b) { return a.offset < b.offset; });
+    return matches;
+}
+
+/**
+* Searches a file for every pattern listed (one per line) in `patternsPath` and prints
+* the number of matches.
+*/
+int searchPatternSetFile(const std::string& patternsPath, const std::string& path) {
+    std::ifstream in(patternsPath);
+    std::vector<std::string> patterns;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty()) patterns.push_back(line);
+    }
+    CompiledPatternSet compiled;
+    if (!compilePatternSet(patterns, compiled)) {
+        std::cerr << "No patterns in " << patternsPath << std::endl;
+        return 1;
+    }
+    MappedFile file;
+    if (!mapFile(path, file)) {
+        std::cerr << "Cannot map " << path << std::endl;
+        return 1;
+    }
+    std::vector<MultiMatch> matches = findPatternSet(file.data, file.size, compiled);
+    unmapFile(file);
+    std::cout << "Patterns: " << patterns.size() << "      - Engine: " << multiEngineName(compiled.engine)
+              << "      - Total Matches: " << matches.size() << std::endl;
+    return 0;
+}
+
+/**
+* Searches a file with the engine the planner picks for `pattern`, or with the one named
+* by `engine` when it is not empty, and prints the engine and the number of matches.
+*/
+int searchPlannedFile(const std::string& pattern, const std::string& path, const std::string& engine = "") {
+    SearchPlan plan;
+    SearchEngine chosen;
+    if (engine.empty()) {
+        planSearch(pattern, plan);
+    } else if (parseEngineName(engine, chosen)) {
+        planSearch(pattern, chosen, plan);
+    } else {
+        std::cerr << "Unknown engine " << engine << std::endl;
+        return 1;
+    }
+    MappedFile file;
+    if (!mapFile(path, file)) {
+        std::cerr << "Cannot map " << path << std::endl;
+        return 1;
+    }
+    std::vector<std::size_t> matches = findMatchesPlanned(file.data, file.size, plan);
+    unmapFile(file);
+    std::cout << "Engine: " << engineName(plan.engine) << "      - Total Matches: " << matches.size() << std::endl;
+    return 0;
+}
+
+// =========================
+// Self-Test
+// =========================
+//
+// `--selftest` runs every engine against a naive search on random texts over two to four
+// letters, where periodic patterns and overlapping matches are common, and on inputs
+// that broke earlier versions of the engines. It reports each disagreement and exits
+// non-zero if there was any.
+
+const int SELFTEST_ROUNDS = 3000;
+const int SELFTEST_MAX_REPORTS = 10;
+
+// Inputs that once produced wrong results: {text, pattern}
+const char* const SELFTEST_REGRESSIONS[][2] = {
+    // Turbo-BM applying its "shift past the memory" rule to a full match's border missed 22
+    {"cbcaccbcbcaccbcbcaccbccbcaccbc", "cbcaccbc"},
+    {"cbcaccbcbcaccbcbcaccbccbcaccbcccbcaccbcbcaccbcbcaccbcbcaccbccbcaccbcbcac", "cbcaccbc"},
+    // Two-Way with a one-byte pattern
+    {"aaa", "a"},
+    {"", "a"},
+};
+
+struct SelfTest {
+    int checks = 0;
+    int failures = 0;
+};
+
+std::vector<std::size_t> findMatchesNaive(const char* text, std::size_t n, const std::string& pattern) {
+    std::vector<std::size_t> matches;
+    const std::size_t m = pattern.length();
+    for (std::size_t i = 0; m > 0 && i + m <= n; i++) {
+        if (std::memcmp(text + i, pattern.data(), m) == 0) matches.push_back(i);
+    }
+    return matches;
+}
+
+void expectMatches(SelfTest& test, const char* engine, const std::string& text, const std::string& pattern,
+                   const std::vector<std::size_t>& got, const std::vector<std::size_t>& expected) {
+    test.checks++;
+    if (got == expected) return;
+    if (++test.failures <= SELFTEST_MAX_REPORTS) {
+        std::cout << "FAIL " << engine << ": pattern \"" << pattern << "\" in \"" << text.substr(0, 80)
+                  << (text.size() > 80 ? "...\"" : "\"") << " found " << got.size() << " of " << expected.size()
+                  << " matches" << std::endl;
+    }
+}
+
+// Runs every single-pattern engine on one text and pattern
+void checkSinglePattern(SelfTest& test, const std::string& text, const std::string& pattern, uint32_t& state) {
+    const char* data = text.data();
+    const std::size_t n = text.size();
+    const std::size_t m = pattern.length();
+    const std::vector<std::size_t> expected = findMatchesNaive(data, n, pattern);
+    const CompiledPattern compiled = compilePattern(pattern);
+    std::vector<std::size_t> got;
+    auto collect = [&](std::size_t offset) { got.push_back(offset); };
+
+    expectMatches(test, "findMatches", text, pattern, findMatches(data, n, compiled), expected);
+    for (int isa = 0; isa < NUM_KERNELS; isa++) {
+        if (!kernelSupported(KernelIsa(isa))) continue;
+        got.clear();
+        if (n >= m) kernelFunction(KernelIsa(isa))(data, compiled, 0, n - m, got);
+        expectMatches(test, kernelName(KernelIsa(isa)), text, pattern, got, expected);
+    }
+    got.clear();
+    if (n >= m) scanBoyerMoore(data, compiled, 0, n - m, collect);
+    expectMatches(test, "scanBoyerMoore", text, pattern, got, expected);
+    if (m <= (std::size_t)SWAR_MAX_PATTERN) {
+        got.clear();
+        if (n >= m) scanSwar(data, compiled, 0, n - m, collect);
+        expectMatches(test, "SWAR", text, pattern, got, expected);
+    }
+    expectMatches(test, "Turbo-BM", text, pattern, findMatchesTurbo(data, n, compiled), expected);
+    expectMatches(test, "Apostolico-Giancarlo", text, pattern, findMatchesApostolicoGiancarlo(data, n, compiled),
+                  expected);
+    expectMatches(test, "Two-Way", text, pattern, findMatchesTwoWay(data, n, compileTwoWay(pattern.data(), m)),
+                  expected);
+    SearchPlan plan;
+    planSearch(pattern, plan);
+    expectMatches(test, "planned", text, pattern, findMatchesPlanned(data, n, plan), expected);
+    // Re-planning one plan for each engine in turn must leave nothing behind from the last
+    for (SearchEngine engine : {SearchEngine::TwoWay, SearchEngine::TurboBoyerMoore, SearchEngine::TwoWay,
+                                SearchEngine::ApostolicoGiancarlo, SearchEngine::BoyerMoore}) {
+        planSearch(pattern, engine, plan);
+        expectMatches(test, (std::string("planned ") + engineName(engine)).c_str(), text, pattern,
+                      findMatchesPlanned(data, n, plan), expected);
+    }
+    expectMatches(test, "parallel", text, pattern, findMatchesParallel(data, n, compiled, 3), expected);
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+    got.clear();
+    for (std::size_t offset : generateMatches(data, n, compiled)) got.push_back(offset);
+    expectMatches(test, "generator", text, pattern, got, expected);
+#endif
+
+    std::size_t skippedBlocks = 0;
+    expectMatches(test, "block summary", text, pattern,
+                  findMatchesWithSummary(data, n, compiled, buildBlockSummary(data, n, 16), skippedBlocks), expected);
+    std::string classSpec;
+    for (char c : pattern) classSpec += std::string("\\") + c;
+    CompiledClassPattern classPattern;
+    compileClassPattern(classSpec, classPattern);
+    expectMatches(test, "class pattern", text, pattern, findClassMatches(data, n, classPattern), expected);
+    std::vector<uint32_t> tokens(text.begin(), text.end());
+    std::vector<uint32_t> tokenPattern(pattern.begin(), pattern.end());
+    expectMatches(test, "token sequence", text, pattern,
+                  findTokenSequence(tokens, compileTokenPattern(tokenPattern)), expected);
+
+    SearchControl control;
+    control.sliceSize = 1 + nextRandom(state) % 8;
+    findMatchesControlled(data, n, compiled, control, got);
+    expectMatches(test, "controlled", text, pattern, got, expected);
+    got.clear();
+    SearchCursor cursor = openSearchCursor(data, n, compiled);
+    while (!advanceCursor(cursor, 1 + nextRandom(state) % 8, collect)) {}
+    expectMatches(test, "cursor", text, pattern, got, expected);
+
+    // Incremental, segmented and streamed search see the text in random pieces
+    got.clear();
+    IncrementalSearcher searcher = openIncrementalSearch(pattern);
+    std::vector<TextSegment> segments;
+    for (std::size_t pos = 0; pos < n;) {
+        std::size_t length = std::min<std::size_t>(n - pos, nextRandom(state) % (m + 2));
+        appendText(searcher, data + pos, length, collect);
+        segments.push_back(TextSegment{data + pos, length});
+        pos += length;
+    }
+    expectMatches(test, "incremental", text, pattern, got, expected);
+    expectMatches(test, "segmented", text, pattern, findMatchesSegmented(segments, compiled), expected);
+    int fds[2];
+    if (pipe(fds) == 0) {
+        got.clear();
+        bool written = writeFully(fds[1], data, n);  // Self-test texts fit in the pipe buffer
+        close(fds[1]);
+        if (written) searchStream(fds[0], compiled, collect, 1 + nextRandom(state) % 16);
+        close(fds[0]);
+        expectMatches(test, "stream", text, pattern, got, expected);
+    }
+
+    // Edit re-search: a random replacement, checked against a naive search of the result
+    TextEdit edit;
+    edit.offset = nextRandom(state) % (n + 1);
+    edit.removedLength = nextRandom(state) % (n - edit.offset + 1);
+    for (uint32_t k = nextRandom(state) % 4; k > 0; k--) edit.insertedBytes += text.empty() ? 'a' : text[nextRandom(state) % n];
+    std::string edited = text;
+    applyTextEdit(edited, edit);
+    std::vector<std::size_t> matches = expected;
+    researchAfterEdit(edited.data(), edited.size(), compiled, edit, matches);
+    expectMatches(test, "edit re-search", edited, pattern, matches, findMatchesNaive(edited.data(), edited.size(), pattern));
+}
+
+// Runs both multi-pattern engines on one text and pattern set
+void checkPatternSet(SelfTest& test, const std::string& text, const std::vector<std::string>& patterns) {
+    std::vector<std::size_t> expected;
+    for (std::size_t i = 0; i < text.size(); i++) {
+        for (std::size_t id = 0; id < patterns.size(); id++) {
+            if (text.compare(i, patterns[id].size(), patterns[id]) == 0) expected.push_back(i * patterns.size() + id);
+        }
+    }
+    std::string label = patterns[0] + " (+" + std::to_string(patterns.size() - 1) + " more)";
+
+    CompiledPatternSet compiled;
+    compilePatternSet(patterns, compiled);
+    for (MultiPatternEngine engine : {MultiPatternEngine::WuManber, MultiPatternEngine::AhoCorasick}) {
+        compiled.engine = engine;
+        if (engine == MultiPatternEngine::WuManber) buildWuManber(compiled.patterns, compiled.wuManber);
+        if (engine == MultiPatternEngine::AhoCorasick) buildAhoCorasick(compiled.patterns, compiled.ahoCorasick);
+        std::vector<std::size_t> got;
+        for (const MultiMatch& match : findPatternSet(text.data(), text.size(), compiled)) {
+            got.push_back(match.offset * patterns.size() + match.patternId);
+        }
+        std::sort(got.begin(), got.end());
+        expectMatches(test, multiEngineName(engine), text, label, got, expected);
+    }
+}
+
+std::string randomText(uint32_t& state, std::size_t length, int alphabet) {
+    std::string text(length, 'a');
+    for (char& c : text) c = "abcd"[nextRandom(state) % alphabet];
+    return text;
+}
+
+/**
+* Checks every kernel on texts that push the vector kernels onto the Boyer-Moore loop: a
+* pattern just over VECTOR_KERNEL_MAX_PATTERN, and a run of `a` where every alignment
+* is a false candidate, with matches planted before and after the budget runs out.
+*/
+void checkKernelFallback(SelfTest& test) {
+    const std::size_t n = 4u << 20;
+    for (std::size_t half : {std::size_t(20), VECTOR_KERNEL_MAX_PATTERN / 2}) {
+        std::string pattern = std::string(half, 'a') + 'b' + std::string(half, 'a');
+        std::string text(n, 'a');
+        for (std::size_t offset : {std::size_t(1000), n / 2, n - pattern.length()}) text[offset + half] = 'b';
+        const std::vector<std::size_t> expected = findMatchesNaive(text.data(), n, pattern);
+        const CompiledPattern compiled = compilePattern(pattern);
+        for (int isa = 0; isa < NUM_KERNELS; isa++) {
+            if (!kernelSupported(KernelIsa(isa))) continue;
+            std::vector<std::size_t> got;
+            kernelFunction(KernelIsa(isa))(text.data(), compiled, 0, n - pattern.length(), got);
+            expectMatches(test, kernelName(KernelIsa(isa)), text, pattern, got, expected);
+        }
+    }
+}
+
+int runSelfTest() {
+    SelfTest test;
+    uint32_t state = 12345;
+    for (const auto& regression : SELFTEST_REGRESSIONS) checkSinglePattern(test, regression[0], regression[1], state);
+
+    for (int round = 0; round < SELFTEST_ROUNDS; round++) {
+        int alphabet = 2 + nextRandom(state) % 3;
+        std::string text = randomText(state, nextRandom(state) % 200, alphabet);
+        std::size_t m = 1 + nextRandom(state) % 10;
+        // Half of the patterns are taken from the text, so most of them occur
+        std::string pattern = randomText(state, m, alphabet);
+        if (round % 2 == 0 && text.size() >= m) pattern = text.substr(nextRandom(state) % (text.size() - m + 1), m);
+        checkSinglePattern(test, text, pattern, state);
+
+        std::vector<std::string> patterns(1 + nextRandom(state) % 20);
+        for (std::string& p : patterns) p = randomText(state, 1 + nextRandom(state) % 8, alphabet);
+        checkPatternSet(test, text, patterns);
+    }
+    checkKernelFallback(test);
+    // Class syntax that must be rejected rather than compiled into a never-matching class
+    for (const char* spec : {"a[z-a]b", "[]", "[a", "a\\"}) {
+        CompiledClassPattern classPattern;
+        test.checks++;
+        if (compileClassPattern(spec, classPattern)) {
+            test.failures++;
+            std::cout << "FAIL class pattern: \"" << spec << "\" was accepted" << std::endl;
+        }
+    }
+
+    std::cout << "Self-test: " << test.checks << " checks, " << test.failures << " failures" << std::endl;
+    return test.failures == 0 ? 0 : 1;
+}
+
+// =========================
+// C API
+// =========================
+//
+// Implements boyer_moore.h. Every entry point catches all exceptions and turns them
+// into a bm_status, so none crosses into the C host. Patterns are compiled through the
+// search planner, and searches run the planned engine over slices of CONTROL_SLICE_SIZE
+// alignments, which bounds the temporary match list and lets a callback stop the
+// search between slices.
+
+struct bm_pattern {
+    SearchPlan plan;
+};
+
+/**
+* Runs the planned engine over the text slice by slice and hands each match to `onMatch`,
+* which returns false to stop. Each slice is searched as the window of text its
+* alignments can read.
+*/
+template <typename OnMatch>
+void forEachMatchInSlices(const char* text, std::size_t n, const SearchPlan& plan, OnMatch&& onMatch) {
+    std::size_t m = plan.compiled.pattern.length();
+    if (n < m) return;
+    const std::size_t lastShift = n - m;
+    for (std::size_t shift = 0; shift <= lastShift;) {
+        std::size_t sliceEnd = lastShift - shift < CONTROL_SLICE_SIZE ? lastShift : shift + CONTROL_SLICE_SIZE - 1;
+        for (std::size_t offset : findMatchesPlanned(text + shift, sliceEnd - shift + m, plan)) {
+            if (!onMatch(shift + offset)) return;
+        }
+        if (sliceEnd == lastShift) return;
+        shift = sliceEnd + 1;
+    }
+}
+
+extern "C" {
+
+int bm_api_version(void) {
+    return BM_API_VERSION;
+}
+
+bm_status bm_compile(const char* pattern, size_t length, bm_pattern** out) {
+    if (out == nullptr) return BM_INVALID_ARGUMENT;
+    *out = nullptr;
+    if (pattern == nullptr || length == 0) return BM_INVALID_ARGUMENT;
+    try {
+        std::unique_ptr<bm_pattern> handle(new bm_pattern);
+        planSearch(std::string(pattern, length), handle->plan);
+        *out = handle.release();
+        return BM_OK;
+    } catch (const std::bad_alloc&) {
+        return BM_OUT_OF_MEMORY;
+    } catch (...) {
+        return BM_INTERNAL_ERROR;
+    }
+}
+
+void bm_free(bm_pattern* pattern) {
+    delete pattern;
+}
+
+bm_status bm_search(const bm_pattern* pattern, const char* text, size_t length,
+                    bm_match_callback callback, void* user_data) {
+    if (pattern == nullptr || callback == nullptr || (text == nullptr && length > 0)) return BM_INVALID_ARGUMENT;
+    try {
+        forEachMatchInSlices(text, length, pattern->plan,
+                             [&](std::size_t offset) { return callback(offset, user_data) == 0; });
+        return BM_OK;
+    } catch (const std::bad_alloc&) {
+        return BM_OUT_OF_MEMORY;
+    } catch (...) {
+        return BM_INTERNAL_ERROR;
+    }
+}
+
+bm_status bm_search_into(const bm_pattern* pattern, const char* text, size_t length,
+                         size_t* offsets, size_t capacity, size_t* count) {
+    if (pattern == nullptr || count == nullptr || (text == nullptr && length > 0) ||
+        (offsets == nullptr && capacity > 0)) {
+        return BM_INVALID_ARGUMENT;
+    }
+    *count = 0;
+    try {
+        std::size_t total = 0;
+        forEachMatchInSlices(text, length, pattern->plan, [&](std::size_t offset) {
+            if (total < capacity) offsets[total] = offset;
+            total++;
+            return true;
+        });
+        *count = total;
+        return BM_OK;
+    } catch (const std::bad_alloc&) {
+        return BM_OUT_OF_MEMORY;
+    } catch (...) {
+        return BM_INTERNAL_ERROR;
+    }
+}
+
+}  // extern "C"
+
+// ============================================================
+// Main Program Entry Point
+// ============================================================
+// Left out with -DBM_BUILD_LIBRARY, which builds the engine as a shared library
+#ifndef BM_BUILD_LIBRARY
+int main(int argc, char* argv[]) {
+    // --kernel=<generic|sse4.2|avx2|avx512> may precede any mode to force a search kernel
+    if (argc >= 2 && std::string(argv[1]).rfind("--kernel=", 0) == 0) {
+        std::string name = std::string(argv[1]).substr(9);
+        if (!forceKernel(name)) {
+            std::cerr << "Kernel " << name << " is unknown or not supported by this CPU" << std::endl;
+            return 1;
+        }
+        argv[1] = argv[0];
+        argc--;
+        argv++;
+    }
+
+    // Daemon modes:  --serve <socket>  |  --query <socket> <pattern> <file>
+    if (argc == 3 && std::string(argv[1]) == "--serve") {
+        return runSearchDaemon(argv[2]);
+    }
+    if (argc == 5 && std::string(argv[1]) == "--query") {
+        return querySearchDaemon(argv[2], argv[3], argv[4]);
+    }
+
+    // Shared-memory ring:  --ring <name> <pattern> <file>  |  --ring-consume <name>
+    if (argc == 5 && std::string(argv[1]) == "--ring") {
+        return produceMatchRing(argv[2], argv[3], argv[4]);
+    }
+    if (argc == 3 && std::string(argv[1]) == "--ring-consume") {
+        return consumeMatchRing(argv[2]);
+    }
+
+    // Streaming:  ... | --stdin <pattern>  (one offset per line, as found)
+    if (argc == 3 && std::string(argv[1]) == "--stdin") {
+        return searchStandardInput(argv[2]);
+    }
+
+    // Log tailing:  --follow <pattern> <file>  (polls every second, scans only appended bytes)
+    if (argc == 4 && std::string(argv[1]) == "--follow") {
+        return followLogFile(argv[2], argv[3]);
+    }
+
+    // Planned search:  --search <pattern> <file> [Boyer-Moore|Turbo-BM|Two-Way|Apostolico-Giancarlo]
+    // (without an engine, the search planner chooses one)
+    if ((argc == 4 || argc == 5) && std::string(argv[1]) == "--search") {
+        return searchPlannedFile(argv[2], argv[3], argc == 5 ? argv[4] : "");
+    }
+
+    // Block summaries:  --indexed <pattern> <file>  (sidecar written to <file>.bmidx)
+    if (argc == 4 && std::string(argv[1]) == "--indexed") {
+        return searchIndexedFile(argv[2], argv[3]);
+    }
+    // Character classes:  --class "<pattern with [..] classes>" <file>
+    if (argc == 4 && std::string(argv[1]) == "--class") {
+        return searchClassPatternFile(argv[2], argv[3]);
+    }
+    // Pattern sets:  --patterns <file with one pattern per line> <file>
+    if (argc == 4 && std::string(argv[1]) == "--patterns") {
+        return searchPatternSetFile(argv[2], argv[3]);
+    }
+    if (argc == 2 && std::string(argv[1]) == "--selftest") {
+        return runSelfTest();
+    }
+    if (argc == 2 && std::string(argv[1]) == "--bench-parallel") {
+        return benchmarkParallelSearch();
+    }
+    if (argc == 2 && std::string(argv[1]) == "--bench-kernels") {
+        return benchmarkKernels();
+    }
+    if (argc == 2 && std::string(argv[1]) == "--bench-pattern-switch") {
+        return benchmarkPatternSwitch();
+    }
+
     std::string text = "AAAAAAB";
     std::string pattern = "AB";
 
@@ -230,3 +4201,4 @@ int main() {
 
     return 0;
 }
+#endif  // BM_BUILD_LIBRARY
@@ -0,0 +1,74 @@
+/**
+* C interface to the Boyer-Moore search engine, for hosts that cannot link C++.
+*
+* Build the engine as a shared library by defining BM_BUILD_LIBRARY, which leaves out
+* the command-line entry point:
+*
+*     g++ -std=c++20 -O2 -fPIC -shared -fvisibility=hidden -DBM_BUILD_LIBRARY \
+*         main.cpp -o libboyermoore.so -pthread
+*
+* Patterns are opaque handles. A compiled pattern is immutable and may be shared by any
+* number of threads searching at the same time. No function throws or lets a C++
+* exception escape; failures are reported through bm_status.
+*/
+#ifndef BOYER_MOORE_H
+#define BOYER_MOORE_H
+
+#include <stddef.h>
+
+#if defined(__GNUC__)
+#define BM_EXPORT __attribute__((visibility("default")))
+#else
+#define BM_EXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BM_API_VERSION 1
+
+typedef struct bm_pattern bm_pattern;
+
+typedef enum bm_status {
+    BM_OK = 0,
+    BM_INVALID_ARGUMENT = 1,  /* Null handle or output pointer, or an empty pattern */
+    BM_OUT_OF_MEMORY = 2,
+    BM_INTERNAL_ERROR = 3
+} bm_status;
+
+/**
+* Receives each match offset, in increasing order. Returning nonzero stops the search;
+* no further matches are reported.
+*/
+typedef int (*bm_match_callback)(size_t offset, void* user_data);
+
+/* BM_API_VERSION of the library actually loaded */
+BM_EXPORT int bm_api_version(void);
+
+/**
+* Compiles a pattern of `length` bytes (which may contain NUL bytes).
+* On success `*out` receives a handle to be released with bm_free.
+*/
+BM_EXPORT bm_status bm_compile(const char* pattern, size_t length, bm_pattern** out);
+
+/* Releases a compiled pattern; null is ignored */
+BM_EXPORT void bm_free(bm_pattern* pattern);
+
+/* Reports every match of `pattern` in the text to `callback`, which receives `user_data` */
+BM_EXPORT bm_status bm_search(const bm_pattern* pattern, const char* text, size_t length,
+                              bm_match_callback callback, void* user_data);
+
+/**
+* Writes the first `capacity` match offsets to `offsets` and the total number of
+* matches to `*count`, which may exceed `capacity`. `offsets` may be null when
+* `capacity` is 0, to count matches only.
+*/
+BM_EXPORT bm_status bm_search_into(const bm_pattern* pattern, const char* text, size_t length,
+                                   size_t* offsets, size_t capacity, size_t* count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOYER_MOORE_H */